@@ -17,6 +17,8 @@ os.chdir(WORKING_DIR)
 
 
 NUM_LIGHTS = list(range(0,2001,25)) # list(range(0,1000+1,25))
+# Sparser past 2000, where the light BVH (--lightBVH) takes over.
+NUM_LIGHTS += [2500, 5000, 10000, 20000, 50000, 100000]
 PIPELINES = [
     #'none',
     #'clay',
@@ -28,14 +30,21 @@ PIPELINES = [
     #'forward-boundingsphere',
     'forward-clustered-gpu',
 ]
+# Extra flags per run, keyed by the suffix added to the pipeline name in the log file.
+FLAGS = {
+    '': '',
+    '-bvh': '--lightBVH',
+    '-active': '--activeClusters',
+    '-precull': '--preCullLights',
+}
 
 
 if __name__ == '__main__':
 
-    for nlights, pipeline in tqdm(list(itertools.product(NUM_LIGHTS, PIPELINES))):
-        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, pipeline)
+    for nlights, pipeline, (suffix, flags) in tqdm(list(itertools.product(NUM_LIGHTS, PIPELINES, FLAGS.items()))):
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, pipeline + suffix)
         working_dir = f'{Path(WORKING_DIR).absolute()}'.replace('\\', '/')
-        command = f'"{EXEC_REL_PATH}" --lights {nlights} --pipeline {pipeline} --eval --log-file "{log_file}"'
+        command = f'"{EXEC_REL_PATH}" --lights {nlights} --pipeline {pipeline} {flags} --eval --log-file "{log_file}"'
         print(command)
         subp = subprocess.Popen(
             command,
@@ -0,0 +1,72 @@
+from pathlib import Path
+import subprocess
+import itertools
+import json
+from tqdm import tqdm
+import os
+
+
+# Measures how much of the CPU light culling --asyncCulling hides: runs each CPU culling
+# pipeline synchronously and asynchronously with --cullingStats and prints the mean time
+# spent building the lists, the part of it the frame didn't wait for, and the frametime.
+
+WORKING_DIR = './render_engine'
+EXEC_REL_PATH = '../x64/Release/render_engine.exe'
+LOG_FILE_DIR = 'D:/cs348k_eval/async/'
+LOG_FILENAME = '{1}_nlights={0:05d}.json'
+
+os.chdir(WORKING_DIR)
+
+
+
+NUM_LIGHTS = [100, 500, 1000, 2000, 5000]
+PIPELINES = [
+    'deferred-tiled-cpu',
+    'deferred-clustered-cpu',
+    'deferred-binned-cpu',
+    'forward-tiled-cpu',
+    'forward-clustered-cpu',
+    'forward-binned-cpu',
+]
+# Suffix added to the pipeline name in the log file, and the flags.
+MODES = {
+    'sync': '',
+    'async': '--asyncCulling',
+    'latency': '--asyncCullingLatency',
+}
+
+
+def summarize(log_file):
+    with open(log_file) as f:
+        log = json.load(f)
+    stats = log['cullingStats']
+    n = len(stats)
+    frametimes = log['frametimes']
+    cull = sum(s['cullMs'] for s in stats) / n
+    hidden = sum(s['hiddenMs'] for s in stats) / n
+    return {
+        'cullMs': cull,
+        'hiddenMs': hidden,
+        'hidden': hidden / cull if cull > 0 else 0.0,
+        'ms': 1000 * sum(frametimes) / len(frametimes),
+    }
+
+
+if __name__ == '__main__':
+
+    runs = list(itertools.product(NUM_LIGHTS, PIPELINES, MODES.items()))
+    for nlights, pipeline, (mode, flags) in tqdm(runs):
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-{mode}')
+        command = f'"{EXEC_REL_PATH}" --lights {nlights} --pipeline {pipeline} {flags} --cullingStats --eval --log-file "{log_file}"'
+        print(command)
+        subp = subprocess.Popen(
+            command,
+            shell=True
+        )
+        subp.wait()
+
+    print(f'{"pipeline":<24} {"lights":>6} {"mode":<8} {"cullMs":>7} {"hiddenMs":>8} {"hidden":>7} {"ms":>7}')
+    for nlights, pipeline, (mode, flags) in runs:
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-{mode}')
+        s = summarize(log_file)
+        print(f'{pipeline:<24} {nlights:>6} {mode:<8} {s["cullMs"]:>7.3f} {s["hiddenMs"]:>8.3f} {s["hidden"]:>7.1%} {s["ms"]:>7.2f}')
@@ -0,0 +1,93 @@
+from pathlib import Path
+import subprocess
+import itertools
+import json
+import numpy as np
+from PIL import Image
+from tqdm import tqdm
+import os
+
+
+# Trades image quality for per-pixel light count with light LOD (--lightLOD): runs each
+# pipeline exactly and with every setting below, once with --cullingStats for the light
+# counts and frametimes, and once with --render-dir to compare the frames to the exact ones.
+
+WORKING_DIR = './render_engine'
+EXEC_REL_PATH = '../x64/Release/render_engine.exe'
+LOG_FILE_DIR = 'D:/cs348k_eval/lod/'
+LOG_FILENAME = '{1}_nlights={0:05d}.json'
+RENDER_DIRNAME = '{1}_nlights={0:05d}'
+
+os.chdir(WORKING_DIR)
+
+
+
+NUM_LIGHTS = [1000, 5000, 20000]
+PIPELINES = [
+    'deferred-clustered-gpu',
+    'forward-clustered-gpu',
+]
+# (screen size, error budget); None is the exact reference.
+SETTINGS = [None, (0.05, 0.005), (0.1, 0.01), (0.2, 0.02), (0.2, 0.05)]
+
+
+def run_name(pipeline, setting):
+    if setting is None:
+        return f'{pipeline}-exact'
+    return f'{pipeline}-lod{setting[0]}-{setting[1]}'
+
+
+def run(command):
+    print(command)
+    subp = subprocess.Popen(
+        command,
+        shell=True
+    )
+    subp.wait()
+
+
+def image_difference(render_dir, reference_dir):
+    errors = []
+    for reference in sorted(Path(reference_dir).glob('*.jpg')):
+        a = np.asarray(Image.open(reference), dtype=np.float64)
+        b = np.asarray(Image.open(Path(render_dir) / reference.name), dtype=np.float64)
+        errors.append(np.mean((a - b) ** 2))
+    mse = sum(errors) / len(errors)
+    psnr = 10 * np.log10(255 ** 2 / mse) if mse > 0 else float('inf')
+    return np.sqrt(mse), psnr
+
+
+def summarize(log_file):
+    with open(log_file) as f:
+        log = json.load(f)
+    stats = log['cullingStats']
+    n = max(len(stats), 1)
+    frametimes = log['frametimes']
+    return {
+        'lights': sum(s.get('lodLights', 1.0) for s in stats) / n,
+        'mean': sum(s['meanLights'] for s in stats) / n,
+        'ms': 1000 * sum(frametimes) / len(frametimes),
+    }
+
+
+if __name__ == '__main__':
+
+    runs = list(itertools.product(NUM_LIGHTS, PIPELINES, SETTINGS))
+    for nlights, pipeline, setting in tqdm(runs):
+        name = run_name(pipeline, setting)
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, name)
+        render_dir = Path(LOG_FILE_DIR) / RENDER_DIRNAME.format(nlights, name)
+        flags = '' if setting is None else f'--lodScreenSize {setting[0]} --lodError {setting[1]}'
+        command = f'"{EXEC_REL_PATH}" --lights {nlights} --pipeline {pipeline} {flags} --eval'
+        # Saving frames slows the run down, so time it separately.
+        run(f'{command} --cullingStats --log-file "{log_file}"')
+        run(f'{command} --render-dir "{render_dir}"')
+
+    print(f'{"pipeline":<24} {"lights":>6} {"screenSize":>10} {"error":>6} {"left":>6} {"mean":>7} {"ms":>7} {"rmse":>6} {"psnr":>6}')
+    for nlights, pipeline, setting in runs:
+        name = run_name(pipeline, setting)
+        s = summarize(Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, name))
+        rmse, psnr = image_difference(Path(LOG_FILE_DIR) / RENDER_DIRNAME.format(nlights, name),
+            Path(LOG_FILE_DIR) / RENDER_DIRNAME.format(nlights, run_name(pipeline, None)))
+        screen_size, error = setting if setting is not None else ('-', '-')
+        print(f'{pipeline:<24} {nlights:>6} {screen_size:>10} {error:>6} {s["lights"]:>6.1%} {s["mean"]:>7.2f} {s["ms"]:>7.2f} {rmse:>6.2f} {psnr:>6.1f}')
@@ -0,0 +1,62 @@
+from pathlib import Path
+import subprocess
+import itertools
+import json
+from tqdm import tqdm
+import os
+
+
+# Compares the depth slicing schemes (--depthSlicing) on the eval trajectory: runs each
+# pipeline with --cullingStats and prints the lights-per-cluster distribution per scheme.
+
+WORKING_DIR = './render_engine'
+EXEC_REL_PATH = '../x64/Release/render_engine.exe'
+LOG_FILE_DIR = 'D:/cs348k_eval/slicing/'
+LOG_FILENAME = '{1}_nlights={0:05d}.json'
+
+os.chdir(WORKING_DIR)
+
+
+
+NUM_LIGHTS = [100, 500, 1000, 2000, 5000]
+PIPELINES = [
+    'deferred-clustered-gpu',
+    'forward-clustered-gpu',
+]
+SLICING = ['exponential', 'linear', 'hybrid', 'adaptive']
+
+
+def summarize(log_file):
+    with open(log_file) as f:
+        log = json.load(f)
+    stats = log['cullingStats']
+    n = len(stats)
+    frametimes = log['frametimes']
+    return {
+        'empty': sum(s['emptyClusters'] / s['clusters'] for s in stats) / n,
+        'mean': sum(s['meanLights'] for s in stats) / n,
+        'p99': sum(s['p99Lights'] for s in stats) / n,
+        'max': max(s['maxLights'] for s in stats),
+        'overBudget': sum(s['overBudgetClusters'] / s['clusters'] for s in stats) / n,
+        'ms': 1000 * sum(frametimes) / len(frametimes),
+    }
+
+
+if __name__ == '__main__':
+
+    runs = list(itertools.product(NUM_LIGHTS, PIPELINES, SLICING))
+    for nlights, pipeline, slicing in tqdm(runs):
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-{slicing}')
+        command = f'"{EXEC_REL_PATH}" --lights {nlights} --pipeline {pipeline} --depthSlicing {slicing} --cullingStats --eval --log-file "{log_file}"'
+        print(command)
+        subp = subprocess.Popen(
+            command,
+            shell=True
+        )
+        subp.wait()
+
+    print(f'{"pipeline":<24} {"lights":>6} {"slicing":<12} {"empty":>6} {"mean":>7} {"p99":>6} {"max":>5} {"overBudget":>10} {"ms":>7}')
+    for nlights, pipeline, slicing in runs:
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-{slicing}')
+        s = summarize(log_file)
+        print(f'{pipeline:<24} {nlights:>6} {slicing:<12} {s["empty"]:>6.1%} {s["mean"]:>7.2f} {s["p99"]:>6.1f} {s["max"]:>5} {s["overBudget"]:>10.2%} {s["ms"]:>7.2f}')
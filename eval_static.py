@@ -0,0 +1,69 @@
+from pathlib import Path
+import subprocess
+import itertools
+import json
+from tqdm import tqdm
+import os
+
+
+# Measures what --staticLightGrid saves: runs each pipeline with a fraction of the spawned
+# lights static (--staticLights), with and without the grid, and prints the mean culling
+# time of the CPU pipelines, the mean lights per cluster left to the per-frame lists, and
+# the frametime.
+
+WORKING_DIR = './render_engine'
+EXEC_REL_PATH = '../x64/Release/render_engine.exe'
+LOG_FILE_DIR = 'D:/cs348k_eval/static/'
+LOG_FILENAME = '{1}_nlights={0:05d}.json'
+
+os.chdir(WORKING_DIR)
+
+
+
+NUM_LIGHTS = [1000, 5000, 20000]
+STATIC_FRACTIONS = [0.5, 0.9]
+PIPELINES = [
+    'deferred-binned-cpu',
+    'deferred-clustered-gpu',
+    'forward-binned-cpu',
+    'forward-clustered-gpu',
+]
+# Suffix added to the pipeline name in the log file, and the flags.
+MODES = {
+    'culled': '',
+    'grid': '--staticLightGrid',
+}
+
+
+def summarize(log_file):
+    with open(log_file) as f:
+        log = json.load(f)
+    stats = log['cullingStats']
+    n = max(len(stats), 1)
+    frametimes = log['frametimes']
+    cull = [s['cullMs'] for s in stats if s.get('cullMs', -1) >= 0]
+    return {
+        'cullMs': sum(cull) / len(cull) if cull else float('nan'),
+        'meanLights': sum(s['meanLights'] for s in stats) / n,
+        'ms': 1000 * sum(frametimes) / len(frametimes),
+    }
+
+
+if __name__ == '__main__':
+
+    runs = list(itertools.product(NUM_LIGHTS, STATIC_FRACTIONS, PIPELINES, MODES.items()))
+    for nlights, fraction, pipeline, (mode, flags) in tqdm(runs):
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-static{fraction}-{mode}')
+        command = f'"{EXEC_REL_PATH}" --lights {nlights} --staticLights {fraction} --pipeline {pipeline} {flags} --cullingStats --eval --log-file "{log_file}"'
+        print(command)
+        subp = subprocess.Popen(
+            command,
+            shell=True
+        )
+        subp.wait()
+
+    print(f'{"pipeline":<24} {"lights":>6} {"static":>6} {"mode":<7} {"cullMs":>7} {"mean":>6} {"ms":>7}')
+    for nlights, fraction, pipeline, (mode, flags) in runs:
+        log_file = Path(LOG_FILE_DIR) / LOG_FILENAME.format(nlights, f'{pipeline}-static{fraction}-{mode}')
+        s = summarize(log_file)
+        print(f'{pipeline:<24} {nlights:>6} {fraction:>6.0%} {mode:<7} {s["cullMs"]:>7.3f} {s["meanLights"]:>6.2f} {s["ms"]:>7.2f}')
@@ -0,0 +1,730 @@
+/*
+* Headless benchmark for the lightculling library (LightCullingCPU).
+* Generates synthetic light distributions, views them from the recorded eval
+* trajectory, and runs every CPU culler over each view. Reports the time per light
+* and the lights-per-cluster distribution of each culler, and checks every list
+* against the brute-force references (cullTilesReference, cullClustersReference).
+* Exits with 1 if any culler drops a light the reference keeps. "extra" counts the
+* lights a culler keeps that the reference rejects; they are only a cost.
+* Also measures light LOD (buildLightLOD): how many lights it leaves, the lights per
+* cluster after it, and the light intensity it gets wrong at the cluster centers.
+* And the static light grid (buildStaticLightGrid), built once over all the lights in
+* world space: its build time and size, checked at random points against every light.
+*/
+#include "graphics/pipeline/lightculling_cpu.h"
+#include "utils/threadpool.h"
+
+#include "glm/glm.hpp"
+#include "glm/ext/matrix_clip_space.hpp"
+
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// A light in world space: its bounding sphere and, for spot lights, its cone.
+struct WorldLight {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 coneApex = glm::vec3(0.0f);
+    glm::vec3 coneAxis = glm::vec3(0.0f);
+    float coneRange = 0.0f;
+    float coneAngle = 0.0f;
+};
+
+// Same spheres as GO_Light::getBoundingSphere().
+static WorldLight makeSpotLight(glm::vec3 apex, glm::vec3 axis, float range, float angle) {
+    WorldLight light;
+    if (angle <= glm::radians(45.0f)) {
+        float radius = range / (2.0f * std::cos(angle));
+        light.position = apex + radius * axis;
+        light.radius = radius;
+    }
+    else {
+        light.position = apex + range * std::cos(angle) * axis;
+        light.radius = range * std::sin(angle);
+    }
+    light.coneApex = apex;
+    light.coneAxis = axis;
+    light.coneRange = range;
+    light.coneAngle = angle;
+    return light;
+}
+
+/*
+* Lights in a box around the pirates scene (centered on the origin, like its LIGHT_SPAWN
+* objects). uniform: anywhere in the box. clumped: gaussian clumps around a few random
+* centers. layer: a thin layer near the ground, which is where the demo spawns them.
+*/
+static std::vector<WorldLight> generateLights(
+    const std::string& distribution,
+    size_t numLights,
+    float spotFraction,
+    glm::vec2 radiusRange,
+    uint32_t seed
+) {
+    const glm::vec3 boxMin = glm::vec3(-12.0f, -1.0f, -12.0f);
+    const glm::vec3 boxMax = glm::vec3(12.0f, 5.0f, 12.0f);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    auto inBox = [&]() {
+        return boxMin + glm::vec3(unit(rng), unit(rng), unit(rng)) * (boxMax - boxMin);
+    };
+
+    std::vector<glm::vec3> clumps(16);
+    for (glm::vec3& c : clumps) {
+        c = inBox();
+    }
+    std::normal_distribution<float> spread(0.0f, 1.0f);
+
+    std::vector<WorldLight> lights(numLights);
+    for (WorldLight& light : lights) {
+        glm::vec3 pos;
+        if (distribution == "clumped") {
+            pos = clumps[rng() % clumps.size()] + glm::vec3(spread(rng), spread(rng), spread(rng));
+        }
+        else if (distribution == "layer") {
+            pos = inBox();
+            pos.y = boxMin.y + 0.5f * unit(rng);
+        }
+        else {
+            pos = inBox();
+        }
+        float range = radiusRange.x + (radiusRange.y - radiusRange.x) * unit(rng);
+        if (unit(rng) < spotFraction) {
+            // Aim roughly downwards, like the demo's spot lights.
+            glm::vec3 axis = glm::normalize(glm::vec3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+            light = makeSpotLight(pos, axis, range, glm::radians(35.0f));
+        }
+        else {
+            light.position = pos;
+            light.radius = range;
+        }
+    }
+    return lights;
+}
+
+static void toViewSpace(
+    std::vector<LightCullingCPU::LightVolume>& volumes,
+    const std::vector<WorldLight>& lights,
+    const glm::mat4& viewMatrix
+) {
+    volumes.resize(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        const WorldLight& light = lights[i];
+        LightCullingCPU::LightVolume& lv = volumes[i];
+        lv = LightCullingCPU::LightVolume();
+        lv.position = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+        lv.radius = light.radius;
+        if (light.coneRange > 0.0f) {
+            lv.coneApex = glm::vec3(viewMatrix * glm::vec4(light.coneApex, 1.0f));
+            lv.coneAxis = glm::normalize(glm::vec3(viewMatrix * glm::vec4(light.coneAxis, 0.0f)));
+            lv.coneRange = light.coneRange;
+            lv.coneSin = std::sin(light.coneAngle);
+            lv.coneCos = std::cos(light.coneAngle);
+        }
+    }
+}
+
+// Converts cullClustersBitset() output to index lists, for comparing.
+static void bitsetToLists(
+    const std::vector<int32_t>& bits,
+    size_t numClusters,
+    size_t numLights,
+    std::vector<int32_t>& tileLightMapping,
+    std::vector<int32_t>& lightsIndex
+) {
+    size_t words = LightCullingCPU::bitsetWords(numLights);
+    tileLightMapping.resize(2 * numClusters);
+    lightsIndex.clear();
+    for (size_t c = 0; c < numClusters; c++) {
+        tileLightMapping[2 * c] = (int32_t)lightsIndex.size();
+        for (size_t w = 0; w < words; w++) {
+            uint32_t word = (uint32_t)bits[c * words + w];
+            for (uint32_t b = 0; b < 32; b++) {
+                if (word & (1u << b)) {
+                    lightsIndex.push_back((int32_t)(32 * w + b));
+                }
+            }
+        }
+        tileLightMapping[2 * c + 1] = (int32_t)lightsIndex.size() - tileLightMapping[2 * c];
+    }
+}
+
+/*
+* binLights() only visits the clusters in each light's lightClusterRange(), while the
+* reference tests every cluster's AABB, which is looser than the cluster's frustum
+* cell. Drops the reference entries outside those ranges, so binned lists can be
+* checked exactly.
+*/
+static void clipToLightRanges(
+    const std::vector<LightCullingCPU::LightVolume>& volumes,
+    glm::ivec3 numTiles,
+    const glm::mat4& projMatrix,
+    const LightCullingCPU::DepthSlicing& slicing,
+    const std::vector<int32_t>& refMapping,
+    const std::vector<int32_t>& refIndex,
+    std::vector<int32_t>& tileLightMapping,
+    std::vector<int32_t>& lightsIndex
+) {
+    glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+    std::vector<LightCullingCPU::LightClusterRange> ranges(volumes.size());
+    for (size_t i = 0; i < volumes.size(); i++) {
+        if (!LightCullingCPU::lightClusterRange(volumes[i], numTiles, projScale, slicing, ranges[i])) {
+            ranges[i].min = glm::ivec4(1);
+            ranges[i].max = glm::ivec4(0);
+        }
+    }
+
+    size_t numClusters = refMapping.size() / 2;
+    tileLightMapping.resize(2 * numClusters);
+    lightsIndex.clear();
+    for (size_t c = 0; c < numClusters; c++) {
+        glm::ivec3 cell = glm::ivec3(
+            (int)(c % numTiles.x), (int)(c / numTiles.x % numTiles.y), (int)(c / ((size_t)numTiles.x * numTiles.y)));
+        tileLightMapping[2 * c] = (int32_t)lightsIndex.size();
+        for (int32_t k = refMapping[2 * c]; k < refMapping[2 * c] + refMapping[2 * c + 1]; k++) {
+            const LightCullingCPU::LightClusterRange& range = ranges[refIndex[k]];
+            if (cell.x >= range.min.x && cell.x <= range.max.x && cell.y >= range.min.y && cell.y <= range.max.y &&
+                cell.z >= range.min.z && cell.z <= range.max.z) {
+                lightsIndex.push_back(refIndex[k]);
+            }
+        }
+        tileLightMapping[2 * c + 1] = (int32_t)lightsIndex.size() - tileLightMapping[2 * c];
+    }
+}
+
+struct ListDiff {
+    size_t missing = 0;     // In the reference list but not the culler's.
+    size_t extra = 0;       // In the culler's list but not the reference.
+};
+
+// Per-cluster set difference; lists may be in any order.
+static ListDiff compareLists(
+    const std::vector<int32_t>& mapping,
+    const std::vector<int32_t>& index,
+    const std::vector<int32_t>& refMapping,
+    const std::vector<int32_t>& refIndex
+) {
+    ListDiff diff;
+    std::vector<int32_t> a, b, out;
+    size_t numClusters = refMapping.size() / 2;
+    for (size_t c = 0; c < numClusters; c++) {
+        a.assign(index.begin() + mapping[2 * c], index.begin() + mapping[2 * c] + mapping[2 * c + 1]);
+        b.assign(refIndex.begin() + refMapping[2 * c], refIndex.begin() + refMapping[2 * c] + refMapping[2 * c + 1]);
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+        out.clear();
+        std::set_difference(b.begin(), b.end(), a.begin(), a.end(), std::back_inserter(out));
+        diff.missing += out.size();
+        out.clear();
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+        diff.extra += out.size();
+    }
+    return diff;
+}
+
+// Lights-per-cluster histogram with power-of-two buckets: 0, 1, 2-3, 4-7, ..., 256+.
+constexpr size_t numBuckets = 10;
+static void addToHistogram(const std::vector<int32_t>& mapping, std::vector<uint64_t>& histogram) {
+    for (size_t c = 0; c < mapping.size() / 2; c++) {
+        uint32_t count = (uint32_t)mapping[2 * c + 1];
+        size_t bucket = 0;
+        while (count > 0 && bucket < numBuckets - 1) {
+            count >>= 1;
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+}
+
+/*
+* Summed light intensity at each cluster center from the lights in its list, with the
+* shaders' quadratic falloff. Accumulates |lod - exact| and exact over all clusters.
+*/
+static void accumulateLODError(
+    const std::vector<LightCullingCPU::ClusterAABB>& clusters,
+    const std::vector<LightCullingCPU::LightVolume>& volumes,
+    const std::vector<LightCullingCPU::LightEmission>& emissions,
+    const std::vector<int32_t>& mapping,
+    const std::vector<int32_t>& index,
+    const std::vector<LightCullingCPU::LightVolume>& lodVolumes,
+    const std::vector<LightCullingCPU::LightEmission>& lodEmissions,
+    const std::vector<int32_t>& lodMapping,
+    const std::vector<int32_t>& lodIndex,
+    double& error,
+    double& total
+) {
+    auto intensity = [&](const std::vector<LightCullingCPU::LightVolume>& vs,
+        const std::vector<LightCullingCPU::LightEmission>& es,
+        const std::vector<int32_t>& map, const std::vector<int32_t>& idx, size_t c, glm::vec3 p) {
+        double sum = 0.0;
+        for (int32_t k = map[2 * c]; k < map[2 * c] + map[2 * c + 1]; k++) {
+            glm::vec3 d = vs[idx[k]].position - p;
+            const LightCullingCPU::LightEmission& e = es[idx[k]];
+            float peak = std::max(std::max(e.color.r, e.color.g), e.color.b);
+            sum += peak / (e.quadratic * std::max(glm::dot(d, d), 1e-4f));
+        }
+        return sum;
+    };
+    for (size_t c = 0; c < clusters.size(); c++) {
+        glm::vec3 p = 0.5f * (glm::vec3(clusters[c].minPoint) + glm::vec3(clusters[c].maxPoint));
+        double exact = intensity(volumes, emissions, mapping, index, c, p);
+        double lod = intensity(lodVolumes, lodEmissions, lodMapping, lodIndex, c, p);
+        error += std::abs(lod - exact);
+        total += exact;
+    }
+}
+
+/*
+* Checks grid at numSamples random points in its bounds: every light whose sphere (or,
+* for spot lights, cone) holds the point must be in the point's cell. Returns the
+* number of lights missing.
+*/
+static size_t checkStaticLightGrid(
+    const LightCullingCPU::StaticLightGrid& grid,
+    const std::vector<LightCullingCPU::LightVolume>& lights,
+    size_t numSamples,
+    uint32_t seed
+) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 extent = grid.cellSize * glm::vec3(grid.dims);
+    size_t missing = 0;
+    std::vector<int32_t> cellLights;
+    for (size_t s = 0; s < numSamples && grid.dims.x > 0; s++) {
+        glm::vec3 p = grid.origin + glm::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+        glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor((p - grid.origin) / grid.cellSize)), glm::ivec3(0), grid.dims - 1);
+        int32_t c = cell.x + grid.dims.x * (cell.y + grid.dims.y * cell.z);
+        cellLights.assign(grid.indices.begin() + grid.cells[2 * c], grid.indices.begin() + grid.cells[2 * c] + grid.cells[2 * c + 1]);
+        for (size_t i = 0; i < lights.size(); i++) {
+            const LightCullingCPU::LightVolume& lv = lights[i];
+            bool lit;
+            if (lv.coneRange > 0.0f) {
+                glm::vec3 v = p - lv.coneApex;
+                float dist = glm::length(v);
+                lit = dist <= lv.coneRange && glm::dot(v, lv.coneAxis) >= lv.coneCos * dist;
+            }
+            else {
+                lit = glm::distance(p, lv.position) <= lv.radius;
+            }
+            if (lit && std::find(cellLights.begin(), cellLights.end(), (int32_t)i) == cellLights.end()) {
+                missing++;
+            }
+        }
+    }
+    return missing;
+}
+
+struct CullerResult {
+    std::string name;
+    double seconds = 0.0;
+    ListDiff diff;
+    LightCullingCPU::CullingStatsRaw raw;
+    size_t numClusters = 0;
+    std::vector<uint64_t> histogram = std::vector<uint64_t>(numBuckets, 0);
+};
+
+void argsError() {
+    std::cout << "Args error\n";
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+
+    std::vector<size_t> light_counts = { 1000, 4000 };
+    std::vector<std::string> distributions = { "uniform", "clumped", "layer" };
+    float spot_fraction = 0.0f;
+    glm::vec2 radius_range = glm::vec2(1.0f, 3.0f);
+    glm::ivec3 numTiles = glm::ivec3(48, 27, 24);
+    size_t num_views = 20;
+    std::string trajectory = "../render_engine/samples/assets/pirates/camera_traj.json";
+    std::string json_file;
+    uint32_t seed = 1;
+    LightCullingCPU::LightLODSettings lod_settings;
+    LightCullingCPU::StaticLightGridSettings static_grid_settings;
+
+    std::vector<std::string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--lights") {
+            if (++i == args.size())
+                argsError();
+            light_counts.clear();
+            std::stringstream list(args[i]);
+            std::string count;
+            while (std::getline(list, count, ','))
+                light_counts.push_back((size_t)std::stoul(count));
+        }
+        else if (args[i] == "--distribution") {
+            if (++i == args.size())
+                argsError();
+            if (args[i] != "all")
+                distributions = { args[i] };
+        }
+        else if (args[i] == "--spotLights") {
+            if (++i == args.size())
+                argsError();
+            spot_fraction = std::stof(args[i]);
+        }
+        else if (args[i] == "--radius") {
+            if (i + 2 >= args.size())
+                argsError();
+            radius_range.x = std::stof(args[++i]);
+            radius_range.y = std::stof(args[++i]);
+        }
+        else if (args[i] == "--numTiles") {
+            if (i + 2 >= args.size())
+                argsError();
+            numTiles.x = std::stoi(args[++i]);
+            numTiles.y = std::stoi(args[++i]);
+        }
+        else if (args[i] == "--numClustersZ") {
+            if (++i == args.size())
+                argsError();
+            numTiles.z = std::stoi(args[i]);
+        }
+        else if (args[i] == "--views") {
+            if (++i == args.size())
+                argsError();
+            num_views = (size_t)std::stoul(args[i]);
+        }
+        else if (args[i] == "--trajectory") {
+            if (++i == args.size())
+                argsError();
+            trajectory = args[i];
+        }
+        else if (args[i] == "--json") {
+            if (++i == args.size())
+                argsError();
+            json_file = args[i];
+        }
+        else if (args[i] == "--lodScreenSize") {
+            if (++i == args.size())
+                argsError();
+            lod_settings.screenSize = std::stof(args[i]);
+        }
+        else if (args[i] == "--lodError") {
+            if (++i == args.size())
+                argsError();
+            lod_settings.errorBudget = std::stof(args[i]);
+        }
+        else if (args[i] == "--staticGridCellSize") {
+            if (++i == args.size())
+                argsError();
+            static_grid_settings.cellSize = std::stof(args[i]);
+        }
+        else if (args[i] == "--seed") {
+            if (++i == args.size())
+                argsError();
+            seed = (uint32_t)std::stoul(args[i]);
+        }
+        else {
+            argsError();
+        }
+    }
+
+    // Views: evenly spaced camera matrices from the eval trajectory.
+    std::ifstream campath_file(trajectory);
+    if (!campath_file) {
+        std::cout << "Can't open trajectory " << trajectory << "\n";
+        exit(1);
+    }
+    json campath = json::parse(campath_file);
+    std::vector<glm::mat4> views;
+    size_t stride = std::max(campath.size() / std::max(num_views, (size_t)1), (size_t)1);
+    for (size_t i = 0; i < campath.size() && views.size() < num_views; i += stride) {
+        auto& m = campath[i];
+        if (m.size() != 16) {
+            std::cout << "TRAJECTORY MATRIX SIZE NOT 16\n";
+            exit(1);
+        }
+        glm::mat4 cameraMatrix;
+        for (int k = 0; k < 16; k++)
+            cameraMatrix[k / 4][k % 4] = m[k].get<float>();
+        views.push_back(glm::inverse(cameraMatrix));
+    }
+
+    // Same projection as the demo camera.
+    const float zNear = 0.1f;
+    const float zFar = 100.0f;
+    glm::mat4 projMatrix = glm::perspective(glm::radians(70.0f), 1920.0f / 1080.0f, zNear, zFar);
+    LightCullingCPU::DepthSlicing slicing = LightCullingCPU::makeDepthSlicing(
+        LightCullingCPU::DepthSlicingMode::Exponential, numTiles.z, zNear, zFar, 0.0f, glm::vec2(0.0f));
+    std::vector<LightCullingCPU::ClusterAABB> clusters;
+    LightCullingCPU::computeClusterAABBs(clusters, numTiles, glm::inverse(projMatrix), slicing);
+    glm::ivec2 numTiles2D = glm::ivec2(numTiles);
+
+    Utils::ThreadPool pool;
+    std::cout << "views: " << views.size() << ", grid: " << numTiles.x << "x" << numTiles.y << "x" << numTiles.z
+        << ", threads: " << pool.getNumThreads() << "\n";
+
+    json results = json::array();
+    bool allPassed = true;
+
+    for (const std::string& distribution : distributions) {
+        for (size_t numLights : light_counts) {
+            std::vector<WorldLight> worldLights = generateLights(distribution, numLights, spot_fraction, radius_range, seed);
+
+            std::vector<CullerResult> cullers(6);
+            cullers[0].name = "tiled";
+            cullers[1].name = "clustered";
+            cullers[2].name = "clustered-bitset";
+            cullers[3].name = "clustered-bvh";
+            cullers[4].name = "binned";
+            cullers[5].name = "reference";
+
+            std::vector<LightCullingCPU::LightVolume> volumes;
+            LightCullingCPU::LightRectsSoA rects;
+            LightCullingCPU::LightBVH bvh;
+            LightCullingCPU::BinningScratch binningScratch;
+            std::vector<int32_t> visible;
+            std::vector<LightCullingCPU::LightClusterRange> ranges;
+            CullerResult preCull;
+            size_t numVisible = 0;
+            // Light LOD. The synthetic lights are white, with the quadratic attenuation of
+            // the demo's lights and the intensity that gives them their radius.
+            std::vector<LightCullingCPU::LightEmission> emissions(numLights);
+            for (size_t i = 0; i < numLights; i++) {
+                float quadratic = 2.0f;
+                float r = worldLights[i].coneRange > 0.0f ? worldLights[i].coneRange : worldLights[i].radius;
+                emissions[i].color = glm::vec3(LightCullingCPU::lightRangeThreshold * quadratic * r * r);
+                emissions[i].quadratic = quadratic;
+            }
+            LightCullingCPU::LightLOD lod;
+            std::vector<LightCullingCPU::LightVolume> lodVolumes;
+            std::vector<LightCullingCPU::LightEmission> lodEmissions;
+            std::vector<int32_t> lodMapping, lodIndex;
+            CullerResult lodResult;
+            size_t numLODLights = 0, numMerged = 0;
+            double lodError = 0.0, lodTotal = 0.0;
+            std::vector<int32_t> tileLights, mapping, index, summary, bits, refMapping, refIndex, tileRefMapping, tileRefIndex, binnedRefMapping, binnedRefIndex;
+
+            auto timed = [](CullerResult& result, const std::function<void()>& cull) {
+                auto start = std::chrono::steady_clock::now();
+                cull();
+                result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+            auto record = [&](CullerResult& result, const std::vector<int32_t>& refMap, const std::vector<int32_t>& refIdx) {
+                ListDiff diff = compareLists(mapping, index, refMap, refIdx);
+                result.diff.missing += diff.missing;
+                result.diff.extra += diff.extra;
+                result.numClusters = mapping.size() / 2;
+                LightCullingCPU::gatherListStats(mapping, index, result.numClusters, numLights, false, 0, result.raw);
+                addToHistogram(mapping, result.histogram);
+            };
+
+            for (const glm::mat4& viewMatrix : views) {
+                toViewSpace(volumes, worldLights, viewMatrix);
+
+                // References first; they aren't timed against anything else.
+                timed(cullers[5], [&]() {
+                    LightCullingCPU::cullClustersReference(clusters, volumes, refMapping, refIndex);
+                });
+                mapping = refMapping;
+                index = refIndex;
+                record(cullers[5], refMapping, refIndex);
+                LightCullingCPU::gatherLightRects(rects, volumes, projMatrix, zNear, zFar);
+                LightCullingCPU::cullTilesReference(rects, numTiles2D, tileRefMapping, tileRefIndex);
+                clipToLightRanges(volumes, numTiles, projMatrix, slicing, refMapping, refIndex, binnedRefMapping, binnedRefIndex);
+
+                timed(cullers[0], [&]() {
+                    LightCullingCPU::gatherLightRects(rects, volumes, projMatrix, zNear, zFar);
+                    LightCullingCPU::cullTiles(rects, numTiles2D, tileLights, mapping, index);
+                });
+                record(cullers[0], tileRefMapping, tileRefIndex);
+
+                timed(cullers[1], [&]() {
+                    LightCullingCPU::cullClusters(pool, clusters, volumes, mapping, index);
+                });
+                record(cullers[1], refMapping, refIndex);
+
+                timed(cullers[2], [&]() {
+                    LightCullingCPU::cullClustersBitset(pool, clusters, volumes, summary, bits);
+                });
+                bitsetToLists(bits, clusters.size(), numLights, mapping, index);
+                record(cullers[2], refMapping, refIndex);
+
+                timed(cullers[3], [&]() {
+                    LightCullingCPU::buildLightBVH(pool, volumes, bvh);
+                    LightCullingCPU::cullClustersBVH(pool, clusters, volumes, bvh, mapping, index);
+                });
+                record(cullers[3], refMapping, refIndex);
+
+                // Not a culler on its own: the frustum pre-cull that feeds the GPU culler.
+                timed(preCull, [&]() {
+                    LightCullingCPU::preCullLights(volumes, numTiles, projMatrix, slicing, visible, ranges);
+                });
+                numVisible += visible.size();
+
+                timed(cullers[4], [&]() {
+                    LightCullingCPU::binLights(clusters, numTiles, volumes, projMatrix, slicing, binningScratch, mapping, index);
+                });
+                record(cullers[4], binnedRefMapping, binnedRefIndex);
+
+                // Not a culler either: light LOD ahead of the clustered culler.
+                timed(lodResult, [&]() {
+                    LightCullingCPU::buildLightLOD(pool, volumes, emissions, projMatrix, lod_settings, lod);
+                });
+                lodVolumes.clear();
+                lodEmissions.clear();
+                for (int32_t i : lod.exact) {
+                    lodVolumes.push_back(volumes[i]);
+                    lodEmissions.push_back(emissions[i]);
+                }
+                for (const LightCullingCPU::AggregateLight& aggregate : lod.aggregates) {
+                    lodVolumes.push_back(aggregate.volume);
+                    lodEmissions.push_back(aggregate.emission);
+                }
+                numLODLights += lodVolumes.size();
+                numMerged += lod.members.size();
+                LightCullingCPU::cullClusters(pool, clusters, lodVolumes, lodMapping, lodIndex);
+                LightCullingCPU::gatherListStats(lodMapping, lodIndex, clusters.size(), lodVolumes.size(), false, 0, lodResult.raw);
+                accumulateLODError(clusters, volumes, emissions, refMapping, refIndex,
+                    lodVolumes, lodEmissions, lodMapping, lodIndex, lodError, lodTotal);
+            }
+
+            std::cout << "\n" << distribution << ", " << numLights << " lights"
+                << (spot_fraction > 0.0f ? " (" + std::to_string(spot_fraction) + " spot)" : std::string()) << "\n";
+            std::cout << std::left << std::setw(18) << "culler" << std::right
+                << std::setw(12) << "ms/view" << std::setw(12) << "ns/light"
+                << std::setw(8) << "mean" << std::setw(6) << "p99" << std::setw(6) << "max"
+                << std::setw(8) << "empty%" << std::setw(10) << "missing" << std::setw(10) << "extra"
+                << "   histogram 0|1|2-3|4-7|...|256+ (% of clusters)\n";
+            for (CullerResult& result : cullers) {
+                LightCullingCPU::CullingStats stats = LightCullingCPU::summarizeCullingStats(result.raw, 0);
+                size_t numViews = std::max(views.size(), (size_t)1);
+                double msPerView = 1e3 * result.seconds / numViews;
+                double nsPerLight = 1e9 * result.seconds / ((double)numViews * std::max(numLights, (size_t)1));
+                uint64_t totalClusters = 0;
+                for (uint64_t n : result.histogram)
+                    totalClusters += n;
+                std::cout << std::left << std::setw(18) << result.name << std::right << std::fixed
+                    << std::setprecision(3) << std::setw(12) << msPerView
+                    << std::setprecision(1) << std::setw(12) << nsPerLight
+                    << std::setw(8) << stats.meanLights << std::setw(6) << stats.p99Lights << std::setw(6) << stats.maxLights
+                    << std::setw(8) << (100.0 * stats.emptyClusters / std::max(stats.numClusters, 1u))
+                    << std::setw(10) << result.diff.missing << std::setw(10) << result.diff.extra << "   ";
+                json histogram = json::array();
+                for (size_t b = 0; b < numBuckets; b++) {
+                    double percent = 100.0 * result.histogram[b] / std::max(totalClusters, (uint64_t)1);
+                    std::cout << (b > 0 ? "|" : "") << std::setprecision(1) << percent;
+                    histogram.push_back(result.histogram[b]);
+                }
+                std::cout << "\n";
+                if (result.diff.missing > 0) {
+                    allPassed = false;
+                }
+
+                results.push_back({
+                    {"distribution", distribution},
+                    {"lights", numLights},
+                    {"spotFraction", spot_fraction},
+                    {"culler", result.name},
+                    {"views", views.size()},
+                    {"msPerView", msPerView},
+                    {"nsPerLight", nsPerLight},
+                    {"meanLights", stats.meanLights},
+                    {"p99Lights", stats.p99Lights},
+                    {"maxLights", stats.maxLights},
+                    {"emptyClusters", stats.emptyClusters},
+                    {"numClusters", stats.numClusters},
+                    {"missing", result.diff.missing},
+                    {"extra", result.diff.extra},
+                    {"histogram", histogram},
+                });
+            }
+
+            size_t numViews = std::max(views.size(), (size_t)1);
+            double preCullMsPerView = 1e3 * preCull.seconds / numViews;
+            double visibleFraction = numVisible / ((double)numViews * std::max(numLights, (size_t)1));
+            std::cout << "pre-cull: " << std::setprecision(3) << preCullMsPerView << " ms/view, "
+                << std::setprecision(1) << 100.0 * visibleFraction << "% of lights visible\n";
+            results.push_back({
+                {"distribution", distribution},
+                {"lights", numLights},
+                {"spotFraction", spot_fraction},
+                {"culler", "precull"},
+                {"views", views.size()},
+                {"msPerView", preCullMsPerView},
+                {"visibleFraction", visibleFraction},
+            });
+
+            double lodMsPerView = 1e3 * lodResult.seconds / numViews;
+            double lodLightFraction = numLODLights / ((double)numViews * std::max(numLights, (size_t)1));
+            double mergedFraction = numMerged / ((double)numViews * std::max(numLights, (size_t)1));
+            double lodRelativeError = lodTotal > 0.0 ? lodError / lodTotal : 0.0;
+            LightCullingCPU::CullingStats lodStats = LightCullingCPU::summarizeCullingStats(lodResult.raw, 0);
+            LightCullingCPU::CullingStats exactStats = LightCullingCPU::summarizeCullingStats(cullers[5].raw, 0);
+            std::cout << "light LOD: " << std::setprecision(3) << lodMsPerView << " ms/view, "
+                << std::setprecision(1) << 100.0 * mergedFraction << "% of lights merged, "
+                << 100.0 * lodLightFraction << "% left, mean " << exactStats.meanLights << " -> "
+                << lodStats.meanLights << " lights/cluster, "
+                << std::setprecision(2) << 100.0 * lodRelativeError << "% intensity error\n";
+            results.push_back({
+                {"distribution", distribution},
+                {"lights", numLights},
+                {"spotFraction", spot_fraction},
+                {"culler", "lod"},
+                {"views", views.size()},
+                {"msPerView", lodMsPerView},
+                {"mergedFraction", mergedFraction},
+                {"lightFraction", lodLightFraction},
+                {"meanLights", lodStats.meanLights},
+                {"p99Lights", lodStats.p99Lights},
+                {"maxLights", lodStats.maxLights},
+                {"relativeError", lodRelativeError},
+                {"screenSize", lod_settings.screenSize},
+                {"errorBudget", lod_settings.errorBudget},
+            });
+
+            // The static light grid, as if every light were static.
+            std::vector<LightCullingCPU::LightVolume> worldVolumes;
+            toViewSpace(worldVolumes, worldLights, glm::mat4(1.0f));
+            LightCullingCPU::StaticLightGrid grid;
+            CullerResult gridResult;
+            timed(gridResult, [&]() {
+                LightCullingCPU::buildStaticLightGrid(worldVolumes, static_grid_settings, grid);
+            });
+            size_t gridMissing = checkStaticLightGrid(grid, worldVolumes, 2000, seed);
+            size_t numCells = grid.cells.size() / 2;
+            double gridMeanLights = grid.indices.size() / (double)std::max(numCells, (size_t)1);
+            std::cout << "static grid: " << std::setprecision(3) << 1e3 * gridResult.seconds << " ms to build, "
+                << grid.dims.x << "x" << grid.dims.y << "x" << grid.dims.z << " cells of " << std::setprecision(2) << grid.cellSize
+                << ", mean " << std::setprecision(1) << gridMeanLights << " lights/cell, "
+                << gridMissing << " missing\n";
+            if (gridMissing > 0) {
+                allPassed = false;
+            }
+            results.push_back({
+                {"distribution", distribution},
+                {"lights", numLights},
+                {"spotFraction", spot_fraction},
+                {"culler", "static-grid"},
+                {"buildMs", 1e3 * gridResult.seconds},
+                {"dims", {grid.dims.x, grid.dims.y, grid.dims.z}},
+                {"cellSize", grid.cellSize},
+                {"meanLights", gridMeanLights},
+                {"entries", grid.indices.size()},
+                {"missing", gridMissing},
+            });
+        }
+    }
+
+    if (!json_file.empty()) {
+        std::ofstream out(json_file);
+        out << results.dump(2);
+    }
+    std::cout << "\n" << (allPassed ? "All cullers match the reference." : "MISMATCH: some lists are missing lights.") << "\n";
+    return allPassed ? 0 : 1;
+}
\ No newline at end of file
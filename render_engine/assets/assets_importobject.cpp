@@ -57,12 +57,13 @@ static void processLight(GO_Light* light, aiLight* in_light) {
             light->color.b << "], attenuation: [" << light->attenuation.x << "," <<
             light->attenuation.y << "," << light->attenuation.z << "]}\n";
         break;
-    case 0://aiLightSource_SPOT:
+    case aiLightSource_SPOT:
         light->type = GO_Light::Type::Spot;
         light->direction = glm::normalize(AssimpUtils::toVec3(in_light->mDirection));
+        // The glTF importer passes glTF's angles through, which are already half-angles.
         light->innerOuterAngles = glm::vec2(
             in_light->mAngleInnerCone,
-            in_light->mAngleInnerCone
+            in_light->mAngleOuterCone
         );
         light->attenuation = glm::vec3(
             in_light->mAttenuationConstant,
@@ -70,6 +71,9 @@ static void processLight(GO_Light* light, aiLight* in_light) {
             in_light->mAttenuationQuadratic
         );
         light->color = AssimpUtils::toVec3(in_light->mColorDiffuse);
+        std::cout << "Spot light: {color:[" << light->color.r << "," << light->color.g << "," <<
+            light->color.b << "], angles: [" << light->innerOuterAngles.x << "," <<
+            light->innerOuterAngles.y << "]}\n";
         break;
     // TODO: Consider supporting area lights.
     default:
@@ -168,10 +168,22 @@ json RenderEngine::launch_eval(
 		done = !this->graphics->pollEvents() || done;
 	}
 
+	// Collected while the context is still current; waits for outstanding GPU readbacks.
+	json cullingStats = json::array();
+	if (RenderPipeline* pipeline = this->graphics->getRenderPipeline()) {
+		cullingStats = pipeline->takeCullingStats();
+	}
+
 	Callbacks_GLFW::unregisterWindow(this->graphics->getWindow());
 	this->graphics->destroyWindow();
 
 	if (log) {
+		if (!cullingStats.empty()) {
+			return json{
+				{"frametimes", loggedFrametimes},
+				{"cullingStats", cullingStats},
+			};
+		}
 		return json(loggedFrametimes);
 	}
 	return json();
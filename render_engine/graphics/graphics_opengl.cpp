@@ -1,4 +1,5 @@
 #include "graphics/graphics_opengl.h"
+#include "graphics/pipeline/lightculling_opengl.h"
 #include "graphics/pipeline/rp_clay_opengl.h"
 #include "graphics/pipeline/rp_temp_opengl.h"
 #include "graphics/pipeline/rp_deferred_opengl.h"
@@ -46,6 +47,8 @@ Graphics_OpenGL::Graphics_OpenGL() {
 }
 
 Graphics_OpenGL::~Graphics_OpenGL() {
+	// Frees its GL objects, so it has to go before the context.
+	this->lightCulling.reset();
 	glfwTerminate();
 	this->window = nullptr;
 };
@@ -88,6 +91,13 @@ void Graphics_OpenGL::setRenderPipeline(RenderPipelineType pipelineType) {
 	}
 }
 
+LightCulling_OpenGL& Graphics_OpenGL::getLightCulling() {
+	if (!this->lightCulling) {
+		this->lightCulling = std::make_unique<LightCulling_OpenGL>();
+	}
+	return *this->lightCulling;
+}
+
 void Graphics_OpenGL::resizeFramebuffer(size_t width, size_t height) {
 	glViewport(0, 0, (GLsizei)width, (GLsizei)height);
 	if (this->pipeline) {
@@ -8,8 +8,11 @@
 #include "GLFW/glfw3native.h"
 
 #include <filesystem>
+#include <memory>
 #include <unordered_map>
 
+class LightCulling_OpenGL;
+
 
 class Graphics_OpenGL : public Graphics {
 public:
@@ -30,6 +33,12 @@ public:
 
 	virtual void setRenderPipeline(RenderPipelineType pipelineType) override;
 
+	/*
+	* Returns the light culling shared by the OpenGL pipelines. It is created on first
+	* use and outlives setRenderPipeline(), so switching pipelines keeps its buffers.
+	*/
+	LightCulling_OpenGL& getLightCulling();
+
 	virtual void resizeFramebuffer(size_t width, size_t height) override;
 
 	virtual GPUMesh* createMesh() override;
@@ -53,6 +62,8 @@ private:
 	GLint GLmajorVersion = 0;
 	GLint GLminorVersion = 0;
 	std::string gpuName;
+
+	std::unique_ptr<LightCulling_OpenGL> lightCulling;
 };
 
 
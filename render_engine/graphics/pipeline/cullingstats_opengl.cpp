@@ -0,0 +1,145 @@
+#include "graphics/pipeline/cullingstats_opengl.h"
+
+#include <algorithm>
+
+
+void CullingStats_OpenGL::beginGPUFrame() {
+	LightCullingCPU::CullingStatsRaw zero;
+	if (this->statsSSBO == 0) {
+		glGenBuffers(1, &this->statsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statsSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)sizeof(zero), (void*)0, GL_DYNAMIC_COPY);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, statsSSBOBinding, this->statsSSBO);
+	}
+	else {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statsSSBO);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(zero), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void CullingStats_OpenGL::gatherGPU(GLuint numClusters, bool bitset, size_t numLights, GLint budget,
+	float visibleFraction, float lodFraction) {
+	int64_t frame = this->frame++;
+	this->poll();
+	auto it = std::find_if(this->readbacks.begin(), this->readbacks.end(),
+		[](const Readback& r) { return r.fence == 0; });
+	if (it == this->readbacks.end()) {
+		return;
+	}
+	Readback& readback = *it;
+
+	if (this->statsShader.getID() == 0) {
+		this->statsShader.readCompute(
+			"shaders/opengl/clustersstats.glsl"
+		);
+	}
+	this->statsShader.bind();
+	this->statsShader.setUniform1i("listFormat", (GLint)bitset);
+	this->statsShader.setUniform1i("numClusters", (GLint)numClusters);
+	this->statsShader.setUniform1i("numLights", (GLint)numLights);
+	this->statsShader.setUniform1i("budget", budget);
+	glDispatchCompute((numClusters + statsGroupSize - 1) / statsGroupSize, 1, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	if (readback.buffer == 0) {
+		glGenBuffers(1, &readback.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)sizeof(LightCullingCPU::CullingStatsRaw), (void*)0, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, this->statsSSBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)0, (GLintptr)0,
+		(GLsizeiptr)sizeof(LightCullingCPU::CullingStatsRaw));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.frame = frame;
+	readback.visibleFraction = visibleFraction;
+	readback.lodFraction = lodFraction;
+}
+
+void CullingStats_OpenGL::addCPU(const LightCullingCPU::CullingStatsRaw& raw, int64_t falsePositives,
+	float rebinnedFraction, float cullMs, float waitMs, float lodFraction) {
+	this->poll();
+	this->results.push_back(LightCullingCPU::summarizeCullingStats(raw, this->frame++));
+	this->results.back().falsePositives = falsePositives;
+	this->results.back().rebinnedFraction = rebinnedFraction;
+	this->results.back().cullMs = cullMs;
+	this->results.back().waitMs = waitMs;
+	this->results.back().lodFraction = lodFraction;
+}
+
+
+void CullingStats_OpenGL::finishReadback(Readback& readback) {
+	glDeleteSync(readback.fence);
+	readback.fence = 0;
+	LightCullingCPU::CullingStatsRaw raw;
+	glBindBuffer(GL_COPY_READ_BUFFER, readback.buffer);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(raw), &raw);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	this->results.push_back(LightCullingCPU::summarizeCullingStats(raw, readback.frame));
+	this->results.back().visibleFraction = readback.visibleFraction;
+	this->results.back().lodFraction = readback.lodFraction;
+}
+
+void CullingStats_OpenGL::poll() {
+	for (Readback& readback : this->readbacks) {
+		if (readback.fence == 0) {
+			continue;
+		}
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			this->finishReadback(readback);
+		}
+	}
+}
+
+json CullingStats_OpenGL::take() {
+	for (Readback& readback : this->readbacks) {
+		if (readback.fence != 0) {
+			// One second; only called when a run is finishing.
+			glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			this->finishReadback(readback);
+		}
+	}
+	std::sort(this->results.begin(), this->results.end(),
+		[](const LightCullingCPU::CullingStats& a, const LightCullingCPU::CullingStats& b) { return a.frame < b.frame; });
+
+	json out = json::array();
+	for (const LightCullingCPU::CullingStats& s : this->results) {
+		json entry = {
+			{"frame", s.frame},
+			{"clusters", s.numClusters},
+			{"emptyClusters", s.emptyClusters},
+			{"overflowingClusters", s.overflowingClusters},
+			{"overBudgetClusters", s.overBudgetClusters},
+			{"maxLights", s.maxLights},
+			{"meanLights", s.meanLights},
+			{"p99Lights", s.p99Lights},
+			{"totalIndices", s.totalIndices},
+		};
+		if (s.falsePositives >= 0) {
+			entry["falsePositives"] = s.falsePositives;
+			entry["falsePositiveRate"] = s.totalIndices > 0 ? s.falsePositives / (double)s.totalIndices : 0.0;
+		}
+		if (s.rebinnedFraction >= 0.0f) {
+			entry["rebinnedLights"] = s.rebinnedFraction;
+		}
+		if (s.visibleFraction >= 0.0f) {
+			entry["visibleLights"] = s.visibleFraction;
+		}
+		if (s.lodFraction >= 0.0f) {
+			entry["lodLights"] = s.lodFraction;
+		}
+		if (s.cullMs >= 0.0f) {
+			entry["cullMs"] = s.cullMs;
+			entry["waitMs"] = s.waitMs;
+			// The culling time that overlapped other work instead of stalling the frame.
+			entry["hiddenMs"] = std::max(s.cullMs - s.waitMs, 0.0f);
+		}
+		out.push_back(entry);
+	}
+	this->results.clear();
+	return out;
+}
\ No newline at end of file
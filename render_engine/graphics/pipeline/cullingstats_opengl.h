@@ -0,0 +1,80 @@
+#pragma once
+#include "graphics/graphics_opengl.h"
+#include "graphics/pipeline/lightculling_cpu.h"
+
+#include <array>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+
+/*
+* Collects LightCullingCPU::CullingStats once per frame for the OpenGL pipelines.
+* CPU-culled frames are summarized immediately. GPU-culled frames run
+* clustersstats.glsl, copy the result into one of a few readback buffers and fence
+* it; poll() picks the results up on a later frame once the fence has signaled,
+* so gathering stats never stalls the CPU on the GPU.
+*/
+class CullingStats_OpenGL {
+public:
+
+	static constexpr GLuint statsSSBOBinding = 7;		// Must align with clustersstats.glsl and clusterscull3.glsl
+	static constexpr GLuint statsGroupSize = 64;		// Must match GROUP_SIZE in clustersstats.glsl
+
+	/*
+	* Zeroes the stats SSBO and binds it. Call before the GPU culler's dispatch so
+	* it can record overflowing clusters.
+	*/
+	void beginGPUFrame();
+
+	/*
+	* Dispatches clustersstats.glsl over the current GPU lists and queues a readback.
+	* If every readback buffer is still in flight, this frame's stats are dropped.
+	* visibleFraction is -1 unless the lights were pre-culled (LightCullingCPU::preCullLights()),
+	* and lodFraction is -1 unless they went through LightCullingCPU::buildLightLOD().
+	*/
+	void gatherGPU(GLuint numClusters, bool bitset, size_t numLights, GLint budget,
+		float visibleFraction = -1.0f, float lodFraction = -1.0f);
+
+	/*
+	* Records stats computed on the CPU for this frame. falsePositives is -1 if it
+	* wasn't measured (see LightCullingCPU::countFalsePositives()); rebinnedFraction
+	* is -1 unless the lists came from LightCullingCPU::binLightsIncremental().
+	* cullMs is how long building the lists took and waitMs how much of that the
+	* render thread spent blocked on them; -1 if not timed. lodFraction as in gatherGPU().
+	*/
+	void addCPU(const LightCullingCPU::CullingStatsRaw& raw, int64_t falsePositives = -1,
+		float rebinnedFraction = -1.0f, float cullMs = -1.0f, float waitMs = -1.0f,
+		float lodFraction = -1.0f);
+
+	/*
+	* Moves any finished readbacks into the results. Never blocks.
+	*/
+	void poll();
+
+	/*
+	* Waits for the outstanding readbacks and returns every frame's stats collected
+	* so far as a JSON array, then clears them.
+	*/
+	json take();
+
+private:
+
+	GLuint statsSSBO = 0;
+	Shader_OpenGL statsShader;
+
+	struct Readback {
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		int64_t frame = 0;
+		float visibleFraction = -1.0f;
+		float lodFraction = -1.0f;
+	};
+	std::array<Readback, 3> readbacks;
+	void finishReadback(Readback& readback);
+
+	int64_t frame = 0;
+	std::vector<LightCullingCPU::CullingStats> results;
+
+};
\ No newline at end of file
@@ -0,0 +1,1354 @@
+#include "graphics/pipeline/lightculling_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace LightCullingCPU {
+
+	// Screen [0,1] on the near plane -> view space.
+	static glm::vec3 screenToView(glm::vec2 screen01, const glm::mat4& inverseProjection) {
+		glm::vec4 clip = glm::vec4(screen01 * 2.0f - 1.0f, -1.0f, 1.0f);
+		glm::vec4 view = inverseProjection * clip;
+		return glm::vec3(view) / view.w;
+	}
+
+	// Where the ray from the eye (the origin) through point crosses the plane z = zDistance.
+	static glm::vec3 eyeRayToZPlane(glm::vec3 point, float zDistance) {
+		return point * (zDistance / point.z);
+	}
+
+	int DepthSlicing::slice(float depth) const {
+		float k;
+		if (depth <= this->zNear) {
+			return 0;
+		}
+		else if (depth < this->split) {
+			k = this->linearSlices * (depth - this->zNear) / (this->split - this->zNear);
+		}
+		else if (this->linearSlices >= this->numSlices) {
+			return this->numSlices - 1;
+		}
+		else {
+			k = this->linearSlices + (this->numSlices - this->linearSlices) *
+				std::log(depth / this->split) / std::log(this->end / this->split);
+		}
+		return std::min(std::max((int)std::floor(k), 0), this->numSlices - 1);
+	}
+
+	float DepthSlicing::sliceNear(int k) const {
+		if (k >= this->numSlices) {
+			return this->zFar;
+		}
+		if (k < this->linearSlices) {
+			return this->zNear + (this->split - this->zNear) * k / this->linearSlices;
+		}
+		return this->split * std::pow(this->end / this->split,
+			(k - this->linearSlices) / (float)(this->numSlices - this->linearSlices));
+	}
+
+	glm::vec4 DepthSlicing::packed() const {
+		return glm::vec4((float)this->linearSlices, this->split, this->end, 0.0f);
+	}
+
+	bool DepthSlicing::operator==(const DepthSlicing& other) const {
+		return this->numSlices == other.numSlices && this->zNear == other.zNear &&
+			this->zFar == other.zFar && this->linearSlices == other.linearSlices &&
+			this->split == other.split && this->end == other.end;
+	}
+
+	DepthSlicing makeDepthSlicing(
+		DepthSlicingMode mode,
+		int numSlices,
+		float zNear,
+		float zFar,
+		float splitDepth,
+		glm::vec2 measuredRange
+	) {
+		DepthSlicing slicing;
+		slicing.numSlices = std::max(numSlices, 1);
+		slicing.zNear = zNear;
+		slicing.zFar = zFar;
+		slicing.linearSlices = 0;
+		slicing.split = zNear;
+		slicing.end = zFar;
+
+		if (mode == DepthSlicingMode::Linear) {
+			slicing.linearSlices = slicing.numSlices;
+			slicing.split = zFar;
+		}
+		else if (mode == DepthSlicingMode::Hybrid && splitDepth > zNear && splitDepth < zFar && slicing.numSlices > 1) {
+			// Pick the linear slice count whose thickness best matches the first exponential slice.
+			slicing.split = splitDepth;
+			float bestMismatch = std::numeric_limits<float>::infinity();
+			for (int m = 1; m < slicing.numSlices; m++) {
+				float linearThickness = (splitDepth - zNear) / m;
+				float expThickness = splitDepth * (std::pow(zFar / splitDepth, 1.0f / (slicing.numSlices - m)) - 1.0f);
+				float mismatch = std::abs(std::log(linearThickness / expThickness));
+				if (mismatch < bestMismatch) {
+					bestMismatch = mismatch;
+					slicing.linearSlices = m;
+				}
+			}
+		}
+		else if (mode == DepthSlicingMode::Adaptive && slicing.numSlices > 2) {
+			// Round outwards to 1/8 octave so the grid (and the cluster AABBs) only change
+			// when the range really moves.
+			float lo = std::exp2(std::floor(std::log2(std::max(measuredRange.x, zNear)) * 8.0f) / 8.0f);
+			float hi = std::exp2(std::ceil(std::log2(std::min(measuredRange.y, zFar)) * 8.0f) / 8.0f);
+			lo = std::max(lo, zNear);
+			hi = std::min(hi, zFar);
+			if (measuredRange.y > measuredRange.x && hi > lo * 1.01f) {
+				// A slice in front of the range only when there is space in front of it.
+				slicing.linearSlices = lo > zNear ? 1 : 0;
+				slicing.split = lo;
+				slicing.end = hi;
+			}
+		}
+		return slicing;
+	}
+
+	void computeClusterAABBs(
+		std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const glm::mat4& inverseProjection,
+		const DepthSlicing& slicing
+	) {
+		clusters.resize((size_t)numTiles.x * numTiles.y * numTiles.z);
+		for (int z = 0; z < numTiles.z; z++) {
+			float tileNear = -slicing.sliceNear(z);
+			float tileFar = -slicing.sliceNear(z + 1);
+			for (int y = 0; y < numTiles.y; y++) {
+				for (int x = 0; x < numTiles.x; x++) {
+					glm::vec3 minPoint_vS = screenToView(
+						glm::vec2(x, y) / glm::vec2(numTiles), inverseProjection);
+					glm::vec3 maxPoint_vS = screenToView(
+						glm::vec2(x + 1, y + 1) / glm::vec2(numTiles), inverseProjection);
+
+					glm::vec3 minPointNear = eyeRayToZPlane(minPoint_vS, tileNear);
+					glm::vec3 minPointFar = eyeRayToZPlane(minPoint_vS, tileFar);
+					glm::vec3 maxPointNear = eyeRayToZPlane(maxPoint_vS, tileNear);
+					glm::vec3 maxPointFar = eyeRayToZPlane(maxPoint_vS, tileFar);
+
+					ClusterAABB& c = clusters[x + numTiles.x * (y + numTiles.y * z)];
+					c.minPoint = glm::vec4(glm::min(
+						glm::min(minPointNear, minPointFar), glm::min(maxPointNear, maxPointFar)), 0.0f);
+					c.maxPoint = glm::vec4(glm::max(
+						glm::max(minPointNear, minPointFar), glm::max(maxPointNear, maxPointFar)), 0.0f);
+				}
+			}
+		}
+	}
+
+
+	uint64_t clusterGridKey(
+		glm::ivec3 numTiles,
+		const glm::mat4& projection,
+		const DepthSlicing& slicing
+	) {
+		// FNV-1a over the raw values.
+		uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		};
+		mix(&numTiles, sizeof(numTiles));
+		mix(&projection, sizeof(projection));
+		mix(&slicing.numSlices, sizeof(slicing.numSlices));
+		mix(&slicing.zNear, sizeof(slicing.zNear));
+		mix(&slicing.zFar, sizeof(slicing.zFar));
+		mix(&slicing.linearSlices, sizeof(slicing.linearSlices));
+		mix(&slicing.split, sizeof(slicing.split));
+		mix(&slicing.end, sizeof(slicing.end));
+		return hash;
+	}
+
+
+	// Range of x / depth over one axis of a sphere (center (c, d0) in the plane of
+	// that axis and the view direction), clipped to depth >= zNear. The extremes are
+	// either tangent points of lines through the eye or ends of the near-plane chord.
+	static glm::vec2 projectedSlopeRange(float c, float d0, float radius, float zNear) {
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		float lenSq = c * c + d0 * d0;
+		float tangentLen = std::sqrt(lenSq - radius * radius);
+		glm::vec2 range = glm::vec2(inf, -inf);
+		for (float side : { -1.0f, 1.0f }) {
+			float x = tangentLen * (c * tangentLen - side * d0 * radius) / lenSq;
+			float depth = tangentLen * (d0 * tangentLen + side * c * radius) / lenSq;
+			if (depth >= zNear) {
+				range = glm::vec2(std::min(range.x, x / depth), std::max(range.y, x / depth));
+			}
+		}
+		float nearOffset = zNear - d0;
+		if (std::abs(nearOffset) < radius) {
+			float halfChord = std::sqrt(radius * radius - nearOffset * nearOffset);
+			range.x = std::min(range.x, (c - halfChord) / zNear);
+			range.y = std::max(range.y, (c + halfChord) / zNear);
+		}
+		return range;
+	}
+
+	bool projectSphere(
+		glm::vec3 center,
+		float radius,
+		glm::vec2 projScale,
+		float zNear,
+		float zFar,
+		glm::vec4& rect,
+		glm::vec2& depthRange
+	) {
+		float depth = -center.z;
+		if (depth + radius < zNear || depth - radius > zFar) {
+			return false;
+		}
+		depthRange = glm::vec2(std::max(depth - radius, zNear), std::min(depth + radius, zFar));
+		if (glm::dot(center, center) <= radius * radius) {
+			// The eye is inside the sphere.
+			constexpr float inf = std::numeric_limits<float>::infinity();
+			rect = glm::vec4(-inf, -inf, inf, inf);
+			return true;
+		}
+		glm::vec2 xRange = projectedSlopeRange(center.x, depth, radius, zNear);
+		glm::vec2 yRange = projectedSlopeRange(center.y, depth, radius, zNear);
+		rect = glm::vec4(
+			0.5f * projScale.x * xRange.x + 0.5f,
+			0.5f * projScale.y * yRange.x + 0.5f,
+			0.5f * projScale.x * xRange.y + 0.5f,
+			0.5f * projScale.y * yRange.y + 0.5f
+		);
+		return true;
+	}
+
+	void gatherLightRects(
+		LightRectsSoA& rects,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		float zNear,
+		float zFar
+	) {
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		const glm::vec4 fullRect = glm::vec4(-inf, -inf, inf, inf);
+		const glm::vec4 emptyRect = glm::vec4(inf, inf, -inf, -inf);
+
+		rects.count = lights.size();
+		rects.paddedCount = (rects.count + simdWidth - 1) / simdWidth * simdWidth;
+		rects.minX.resize(rects.paddedCount);
+		rects.minY.resize(rects.paddedCount);
+		rects.maxX.resize(rects.paddedCount);
+		rects.maxY.resize(rects.paddedCount);
+
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+		for (size_t i = 0; i < rects.paddedCount; i++) {
+			glm::vec4 r = emptyRect;
+			if (i < rects.count) {
+				const LightVolume& lv = lights[i];
+				r = fullRect;
+				if (lv.radius < inf) {
+					glm::vec2 depthRange;
+					if (!projectSphere(lv.position, lv.radius, projScale, zNear, zFar, r, depthRange)) {
+						r = emptyRect;
+					}
+				}
+			}
+			rects.minX[i] = r.x;
+			rects.minY[i] = r.y;
+			rects.maxX[i] = r.z;
+			rects.maxY[i] = r.w;
+		}
+	}
+
+	void cullTiles(
+		const LightRectsSoA& rects,
+		glm::ivec2 numTiles,
+		std::vector<int32_t>& tileLights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		tileLightMapping.resize(2 * (size_t)numTiles.x * numTiles.y);
+		lightsIndex.clear();
+		// The vector kernels store whole registers past the last survivor.
+		tileLights.resize(rects.paddedCount + simdWidth);
+
+		for (int32_t y = 0; y < numTiles.y; y++) {
+			for (int32_t x = 0; x < numTiles.x; x++) {
+				glm::vec4 tileBounds = glm::vec4(
+					(float)x / (float)numTiles.x,
+					(float)y / (float)numTiles.y,
+					(float)(x + 1) / (float)numTiles.x,
+					(float)(y + 1) / (float)numTiles.y
+				);
+				size_t numTileLights = cullLightRects(rects, tileBounds, tileLights.data());
+
+				// Append the tile's lights to the global list and record indices.
+				size_t tile = (size_t)y * numTiles.x + x;
+				tileLightMapping[2 * tile] = (int32_t)lightsIndex.size();
+				tileLightMapping[2 * tile + 1] = (int32_t)numTileLights;
+				lightsIndex.insert(lightsIndex.end(), tileLights.begin(), tileLights.begin() + numTileLights);
+			}
+		}
+	}
+
+	void cullTilesReference(
+		const LightRectsSoA& rects,
+		glm::ivec2 numTiles,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		tileLightMapping.resize(2 * (size_t)numTiles.x * numTiles.y);
+		lightsIndex.clear();
+		for (int32_t y = 0; y < numTiles.y; y++) {
+			for (int32_t x = 0; x < numTiles.x; x++) {
+				float left = (float)x / (float)numTiles.x;
+				float bottom = (float)y / (float)numTiles.y;
+				float right = (float)(x + 1) / (float)numTiles.x;
+				float top = (float)(y + 1) / (float)numTiles.y;
+				size_t tile = (size_t)y * numTiles.x + x;
+				tileLightMapping[2 * tile] = (int32_t)lightsIndex.size();
+				for (size_t i = 0; i < rects.count; i++) {
+					if (rects.minX[i] < right && rects.maxX[i] > left &&
+						rects.minY[i] < top && rects.maxY[i] > bottom) {
+						lightsIndex.push_back((int32_t)i);
+					}
+				}
+				tileLightMapping[2 * tile + 1] = (int32_t)lightsIndex.size() - tileLightMapping[2 * tile];
+			}
+		}
+	}
+
+
+	// Same test as sphereTouchesCluster() in clusterscull3.glsl.
+	static float sqDistPointAABB(const glm::vec3& p, const ClusterAABB& c) {
+		float sqDist = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			float below = std::max(c.minPoint[i] - p[i], 0.0f);
+			float above = std::max(p[i] - c.maxPoint[i], 0.0f);
+			sqDist += below * below + above * above;
+		}
+		return sqDist;
+	}
+
+	// Same test as coneTouchesSphere() in clusterscull3.glsl: the cone against the
+	// cluster's bounding sphere, rejecting it if it is outside the cone's angle or
+	// wholly in front of or behind the cone.
+	static bool coneTouchesCluster(const LightVolume& lv, const ClusterAABB& c) {
+		glm::vec3 center = 0.5f * glm::vec3(c.minPoint + c.maxPoint);
+		float radius = 0.5f * glm::length(glm::vec3(c.maxPoint - c.minPoint));
+		glm::vec3 v = center - lv.coneApex;
+		float vLenSq = glm::dot(v, v);
+		float alongAxis = glm::dot(v, lv.coneAxis);
+		float distToCone = lv.coneCos * std::sqrt(std::max(vLenSq - alongAxis * alongAxis, 0.0f)) - alongAxis * lv.coneSin;
+		return !(distToCone > radius || alongAxis > radius + lv.coneRange || alongAxis < -radius);
+	}
+
+	static bool lightTouchesCluster(const LightVolume& lv, const ClusterAABB& c) {
+		return sqDistPointAABB(lv.position, c) <= lv.radius * lv.radius &&
+			(lv.coneRange <= 0.0f || coneTouchesCluster(lv, c));
+	}
+
+	// Runs appendLights(cluster, list) for every cluster on the pool and stitches the
+	// per-chunk lists into one compact list. The result doesn't depend on the chunking.
+	template<typename AppendLights>
+	static void buildClusterLists(
+		Utils::ThreadPool& pool,
+		size_t numClusters,
+		const AppendLights& appendLights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		tileLightMapping.resize(2 * numClusters);
+		lightsIndex.clear();
+		if (numClusters == 0) {
+			return;
+		}
+
+		// A few chunks per thread keeps the load balanced when lights are clumped.
+		size_t chunkSize = std::max(numClusters / (4 * pool.getNumThreads()), (size_t)1);
+		size_t numChunks = (numClusters + chunkSize - 1) / chunkSize;
+		std::vector<std::vector<int32_t>> chunkLists(numChunks);
+
+		pool.parallelFor(numClusters, chunkSize, [&](size_t begin, size_t end) {
+			std::vector<int32_t>& list = chunkLists[begin / chunkSize];
+			for (size_t c = begin; c < end; c++) {
+				size_t start = list.size();
+				appendLights(c, list);
+				// Offsets are local to the chunk for now; fixed up below.
+				tileLightMapping[2 * c] = (int32_t)start;
+				tileLightMapping[2 * c + 1] = (int32_t)(list.size() - start);
+			}
+		});
+
+		// Exclusive prefix sum over the chunk list sizes gives each chunk's base offset.
+		std::vector<size_t> chunkBase(numChunks);
+		size_t total = 0;
+		for (size_t k = 0; k < numChunks; k++) {
+			chunkBase[k] = total;
+			total += chunkLists[k].size();
+		}
+		lightsIndex.resize(total);
+
+		pool.parallelFor(numClusters, chunkSize, [&](size_t begin, size_t end) {
+			size_t k = begin / chunkSize;
+			std::copy(chunkLists[k].begin(), chunkLists[k].end(), lightsIndex.begin() + chunkBase[k]);
+			for (size_t c = begin; c < end; c++) {
+				tileLightMapping[2 * c] += (int32_t)chunkBase[k];
+			}
+		});
+	}
+
+	void cullClusters(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		buildClusterLists(pool, clusters.size(), [&](size_t c, std::vector<int32_t>& list) {
+			const ClusterAABB& cluster = clusters[c];
+			for (size_t i = 0; i < lights.size(); i++) {
+				const LightVolume& lv = lights[i];
+				if (lightTouchesCluster(lv, cluster)) {
+					list.push_back((int32_t)i);
+				}
+			}
+		}, tileLightMapping, lightsIndex);
+	}
+
+	void cullClustersReference(
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		tileLightMapping.resize(2 * clusters.size());
+		lightsIndex.clear();
+		for (size_t c = 0; c < clusters.size(); c++) {
+			tileLightMapping[2 * c] = (int32_t)lightsIndex.size();
+			for (size_t i = 0; i < lights.size(); i++) {
+				if (lightTouchesCluster(lights[i], clusters[c])) {
+					lightsIndex.push_back((int32_t)i);
+				}
+			}
+			tileLightMapping[2 * c + 1] = (int32_t)lightsIndex.size() - tileLightMapping[2 * c];
+		}
+	}
+
+	// Spreads the low 10 bits of v out to every third bit.
+	static uint32_t expandBits10(uint32_t v) {
+		v &= 0x3ffu;
+		v = (v | (v << 16)) & 0x030000ffu;
+		v = (v | (v << 8)) & 0x0300f00fu;
+		v = (v | (v << 4)) & 0x030c30c3u;
+		v = (v | (v << 2)) & 0x09249249u;
+		return v;
+	}
+
+	// Fills keys[k] with (Morton code of positionOf(k)) << 32 | idOf(k) for k in [0, count),
+	// using 10 bits per axis within the bounding box of the positions.
+	template<typename PositionOf, typename IdOf>
+	static void computeMortonKeys(
+		Utils::ThreadPool& pool,
+		size_t count,
+		const PositionOf& positionOf,
+		const IdOf& idOf,
+		std::vector<uint64_t>& keys
+	) {
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		glm::vec3 lo = glm::vec3(inf);
+		glm::vec3 hi = glm::vec3(-inf);
+		for (size_t k = 0; k < count; k++) {
+			lo = glm::min(lo, positionOf(k));
+			hi = glm::max(hi, positionOf(k));
+		}
+		glm::vec3 extent = hi - lo;
+		glm::vec3 scale = glm::vec3(
+			extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+			extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+			extent.z > 0.0f ? 1023.0f / extent.z : 0.0f
+		);
+		keys.resize(count);
+		size_t chunkSize = std::max(count / (4 * pool.getNumThreads()), (size_t)1024);
+		pool.parallelFor(count, chunkSize, [&](size_t begin, size_t end) {
+			for (size_t k = begin; k < end; k++) {
+				glm::vec3 q = (positionOf(k) - lo) * scale;
+				uint32_t code = expandBits10((uint32_t)q.x) << 2 | expandBits10((uint32_t)q.y) << 1 | expandBits10((uint32_t)q.z);
+				keys[k] = (uint64_t)code << 32 | (uint32_t)idOf(k);
+			}
+		});
+	}
+
+	void radixSortKeys(
+		Utils::ThreadPool& pool,
+		std::vector<uint64_t>& keys,
+		std::vector<uint64_t>& scratch
+	) {
+		constexpr size_t radix = 256;
+		size_t count = keys.size();
+		scratch.resize(count);
+		if (count < 2) {
+			return;
+		}
+		size_t chunkSize = std::max(count / (4 * pool.getNumThreads()), (size_t)4096);
+		size_t numChunks = (count + chunkSize - 1) / chunkSize;
+		std::vector<size_t> offsets(numChunks * radix);
+
+		// An even number of passes, so the result ends up back in keys.
+		for (int shift = 32; shift < 64; shift += 8) {
+			// Count each chunk's digits.
+			std::fill(offsets.begin(), offsets.end(), (size_t)0);
+			pool.parallelFor(count, chunkSize, [&](size_t begin, size_t end) {
+				size_t* histogram = offsets.data() + (begin / chunkSize) * radix;
+				for (size_t k = begin; k < end; k++) {
+					histogram[(keys[k] >> shift) & (radix - 1)]++;
+				}
+			});
+			// Turn the counts into write positions: by digit, then by chunk, which keeps the sort stable.
+			size_t total = 0;
+			for (size_t digit = 0; digit < radix; digit++) {
+				for (size_t chunk = 0; chunk < numChunks; chunk++) {
+					size_t n = offsets[chunk * radix + digit];
+					offsets[chunk * radix + digit] = total;
+					total += n;
+				}
+			}
+			pool.parallelFor(count, chunkSize, [&](size_t begin, size_t end) {
+				size_t* cursor = offsets.data() + (begin / chunkSize) * radix;
+				for (size_t k = begin; k < end; k++) {
+					scratch[cursor[(keys[k] >> shift) & (radix - 1)]++] = keys[k];
+				}
+			});
+			keys.swap(scratch);
+		}
+	}
+
+	void mortonOrder(
+		Utils::ThreadPool& pool,
+		const std::vector<glm::vec3>& points,
+		std::vector<int32_t>& order,
+		MortonScratch& scratch
+	) {
+		computeMortonKeys(pool, points.size(),
+			[&](size_t k) { return points[k]; },
+			[](size_t k) { return (int32_t)k; },
+			scratch.keys);
+		radixSortKeys(pool, scratch.keys, scratch.sortScratch);
+		order.resize(points.size());
+		for (size_t k = 0; k < order.size(); k++) {
+			order[k] = (int32_t)(uint32_t)scratch.keys[k];
+		}
+	}
+
+	// Appends the subtree over bvh.lights[begin, end) depth-first and returns its node index.
+	static int32_t emitBVHNode(LightBVH& bvh, const std::vector<LightVolume>& lights, int32_t begin, int32_t end) {
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		int32_t index = (int32_t)bvh.nodes.size();
+		bvh.nodes.emplace_back();
+		glm::vec3 lo = glm::vec3(inf);
+		glm::vec3 hi = glm::vec3(-inf);
+		int32_t count = 0;
+		if (end - begin <= lightBVHLeafSize) {
+			for (int32_t k = begin; k < end; k++) {
+				const LightVolume& lv = lights[bvh.lights[k]];
+				lo = glm::min(lo, lv.position - lv.radius);
+				hi = glm::max(hi, lv.position + lv.radius);
+			}
+			count = end - begin;
+		}
+		else {
+			// Split where the highest bit that differs across the range flips. The keys
+			// are sorted, so that is a single partition point; equal codes split in half.
+			uint32_t diff = (uint32_t)(bvh.keys[begin] >> 32) ^ (uint32_t)(bvh.keys[end - 1] >> 32);
+			int32_t split = begin + (end - begin) / 2;
+			if (diff != 0) {
+				int bit = 31;
+				while ((diff >> bit) == 0) {
+					bit--;
+				}
+				uint64_t mask = (uint64_t)1 << (32 + bit);
+				split = (int32_t)(std::partition_point(bvh.keys.begin() + begin, bvh.keys.begin() + end,
+					[mask](uint64_t key) { return (key & mask) == 0; }) - bvh.keys.begin());
+			}
+			int32_t left = emitBVHNode(bvh, lights, begin, split);
+			int32_t right = emitBVHNode(bvh, lights, split, end);
+			lo = glm::min(glm::vec3(bvh.nodes[left].boundsMin), glm::vec3(bvh.nodes[right].boundsMin));
+			hi = glm::max(glm::vec3(bvh.nodes[left].boundsMax), glm::vec3(bvh.nodes[right].boundsMax));
+		}
+		LightBVHNode& node = bvh.nodes[index];
+		node.boundsMin = glm::vec4(lo, 0.0f);
+		node.boundsMax = glm::vec4(hi, 0.0f);
+		node.first = count > 0 ? begin : 0;
+		node.count = count;
+		node.skip = (int32_t)bvh.nodes.size();
+		node.pad = 0;
+		return index;
+	}
+
+	void buildLightBVH(
+		Utils::ThreadPool& pool,
+		const std::vector<LightVolume>& lights,
+		LightBVH& bvh
+	) {
+		bvh.nodes.clear();
+		bvh.lights.clear();
+		bvh.unbounded.clear();
+
+		for (size_t i = 0; i < lights.size(); i++) {
+			if (std::isfinite(lights[i].radius)) {
+				bvh.lights.push_back((int32_t)i);
+			}
+			else {
+				bvh.unbounded.push_back((int32_t)i);
+			}
+		}
+		if (bvh.lights.empty()) {
+			return;
+		}
+
+		size_t count = bvh.lights.size();
+		computeMortonKeys(pool, count,
+			[&](size_t k) { return lights[bvh.lights[k]].position; },
+			[&](size_t k) { return bvh.lights[k]; },
+			bvh.keys);
+		radixSortKeys(pool, bvh.keys, bvh.sortScratch);
+		for (size_t k = 0; k < count; k++) {
+			bvh.lights[k] = (int32_t)(uint32_t)bvh.keys[k];
+		}
+
+		// A binary tree with leaves of up to lightBVHLeafSize lights.
+		bvh.nodes.reserve(2 * (count / lightBVHLeafSize + 1));
+		emitBVHNode(bvh, lights, 0, (int32_t)count);
+	}
+
+	void cullClustersBVH(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		const LightBVH& bvh,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		int32_t numNodes = (int32_t)bvh.nodes.size();
+		buildClusterLists(pool, clusters.size(), [&](size_t c, std::vector<int32_t>& list) {
+			const ClusterAABB& cluster = clusters[c];
+			list.insert(list.end(), bvh.unbounded.begin(), bvh.unbounded.end());
+			int32_t n = 0;
+			while (n < numNodes) {
+				const LightBVHNode& node = bvh.nodes[n];
+				bool overlaps =
+					node.boundsMin.x <= cluster.maxPoint.x && node.boundsMax.x >= cluster.minPoint.x &&
+					node.boundsMin.y <= cluster.maxPoint.y && node.boundsMax.y >= cluster.minPoint.y &&
+					node.boundsMin.z <= cluster.maxPoint.z && node.boundsMax.z >= cluster.minPoint.z;
+				if (!overlaps) {
+					n = node.skip;
+					continue;
+				}
+				for (int32_t k = node.first; k < node.first + node.count; k++) {
+					int32_t i = bvh.lights[k];
+					if (lightTouchesCluster(lights[i], cluster)) {
+						list.push_back(i);
+					}
+				}
+				// Inner nodes descend into their first child; leaves move on to skip.
+				n++;
+			}
+		}, tileLightMapping, lightsIndex);
+	}
+
+
+
+	void cullClustersBitset(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& summary,
+		std::vector<int32_t>& bits
+	) {
+		size_t numClusters = clusters.size();
+		size_t numWords = bitsetWords(lights.size());
+		size_t numSummaryWords = bitsetSummaryWords(lights.size());
+		summary.resize(numClusters * numSummaryWords);
+		bits.resize(numClusters * numWords);
+		if (numClusters == 0) {
+			return;
+		}
+
+		size_t chunkSize = std::max(numClusters / (4 * pool.getNumThreads()), (size_t)1);
+		pool.parallelFor(numClusters, chunkSize, [&](size_t begin, size_t end) {
+			for (size_t c = begin; c < end; c++) {
+				const ClusterAABB& cluster = clusters[c];
+				uint32_t* clusterBits = (uint32_t*)bits.data() + c * numWords;
+				uint32_t* clusterSummary = (uint32_t*)summary.data() + c * numSummaryWords;
+				std::fill(clusterSummary, clusterSummary + numSummaryWords, 0u);
+				for (size_t w = 0; w < numWords; w++) {
+					size_t lightsEnd = std::min(32 * w + 32, lights.size());
+					uint32_t word = 0;
+					for (size_t i = 32 * w; i < lightsEnd; i++) {
+						const LightVolume& lv = lights[i];
+						word |= (uint32_t)lightTouchesCluster(lv, cluster) << (i % 32);
+					}
+					clusterBits[w] = word;
+					clusterSummary[w / 32] |= (uint32_t)(word != 0) << (w % 32);
+				}
+			}
+		});
+	}
+
+
+	bool lightClusterRange(
+		const LightVolume& lv,
+		glm::ivec3 numTiles,
+		glm::vec2 projScale,
+		const DepthSlicing& slicing,
+		LightClusterRange& range
+	) {
+		range.min = glm::ivec4(0);
+		range.max = glm::ivec4(numTiles - 1, 0);
+		if (!std::isfinite(lv.radius)) {
+			return true;
+		}
+		glm::vec4 rect;
+		glm::vec2 depthRange;
+		if (!projectSphere(lv.position, lv.radius, projScale, slicing.zNear, slicing.zFar, rect, depthRange)) {
+			return false;
+		}
+		if (rect.z <= 0.0f || rect.x >= 1.0f || rect.w <= 0.0f || rect.y >= 1.0f) {
+			return false;
+		}
+		// Clamp before converting: the rect is infinite when the eye is inside the sphere.
+		range.min.x = (int)std::floor(std::max(rect.x, 0.0f) * numTiles.x);
+		range.min.y = (int)std::floor(std::max(rect.y, 0.0f) * numTiles.y);
+		range.max.x = (int)std::ceil(std::min(rect.z, 1.0f) * numTiles.x) - 1;
+		range.max.y = (int)std::ceil(std::min(rect.w, 1.0f) * numTiles.y) - 1;
+		range.min.z = slicing.slice(depthRange.x);
+		range.max.z = slicing.slice(depthRange.y);
+		return true;
+	}
+
+	void preCullLights(
+		const std::vector<LightVolume>& lights,
+		glm::ivec3 numTiles,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		std::vector<int32_t>& visible,
+		std::vector<LightClusterRange>& ranges
+	) {
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+		visible.clear();
+		ranges.clear();
+		LightClusterRange range;
+		for (size_t i = 0; i < lights.size(); i++) {
+			if (lightClusterRange(lights[i], numTiles, projScale, slicing, range)) {
+				visible.push_back((int32_t)i);
+				ranges.push_back(range);
+			}
+		}
+	}
+
+	// Merges lights[members[0..count)] into one light if that stays within the error budget.
+	static bool mergeLights(
+		const std::vector<LightVolume>& lights,
+		const std::vector<LightEmission>& emissions,
+		const int32_t* members,
+		int32_t count,
+		float projScale,
+		float errorBudget,
+		AggregateLight& aggregate
+	) {
+		float totalWeight = 0.0f;
+		float quadratic = 0.0f;
+		float nearest = std::numeric_limits<float>::infinity();
+		glm::vec3 center = glm::vec3(0.0f);
+		glm::vec3 farField = glm::vec3(0.0f);
+		for (int32_t k = 0; k < count; k++) {
+			const LightVolume& lv = lights[members[k]];
+			const LightEmission& e = emissions[members[k]];
+			float weight = std::max(std::max(e.color.r, e.color.g), e.color.b) / e.quadratic;
+			totalWeight += weight;
+			quadratic += weight * e.quadratic;
+			center += weight * lv.position;
+			farField += e.color / e.quadratic;
+			nearest = std::min(nearest, -lv.position.z);
+		}
+		if (totalWeight <= 0.0f) {
+			return false;
+		}
+		center /= totalWeight;
+		quadratic /= totalWeight;
+		float range = std::sqrt(std::max(std::max(farField.r, farField.g), farField.b) / lightRangeThreshold);
+
+		// Offsets are measured at the nearest member's depth, where they look largest.
+		float maxOffset = errorBudget * nearest / projScale;
+		for (int32_t k = 0; k < count; k++) {
+			const LightVolume& lv = lights[members[k]];
+			float offset = glm::length(lv.position - center);
+			if (offset > maxOffset || offset + lv.radius > range) {
+				return false;
+			}
+		}
+		aggregate.volume = LightVolume();
+		aggregate.volume.position = center;
+		aggregate.volume.radius = range;
+		aggregate.emission.color = farField * quadratic;
+		aggregate.emission.quadratic = quadratic;
+		return true;
+	}
+
+	void buildLightLOD(
+		Utils::ThreadPool& pool,
+		const std::vector<LightVolume>& lights,
+		const std::vector<LightEmission>& emissions,
+		const glm::mat4& projMatrix,
+		const LightLODSettings& settings,
+		LightLOD& lod
+	) {
+		lod.exact.clear();
+		lod.aggregates.clear();
+		lod.members.clear();
+		lod.candidates.clear();
+		lod.candidateVolumes.clear();
+		lod.merged.assign(lights.size(), 0);
+
+		// The sphere spans radius * projScale / depth of the viewport height.
+		float projScale = projMatrix[1][1];
+		for (size_t i = 0; i < lights.size(); i++) {
+			const LightVolume& lv = lights[i];
+			float depth = -lv.position.z;
+			bool small = lv.coneRange == 0.0f && std::isfinite(lv.radius) && emissions[i].quadratic > 0.0f &&
+				depth > lv.radius && lv.radius * projScale < settings.screenSize * depth;
+			if (small) {
+				lod.candidates.push_back((int32_t)i);
+				lod.candidateVolumes.push_back(lv);
+			}
+		}
+
+		if (lod.candidates.size() >= 2) {
+			buildLightBVH(pool, lod.candidateVolumes, lod.tree);
+			const std::vector<LightBVHNode>& nodes = lod.tree.nodes;
+			int32_t numNodes = (int32_t)nodes.size();
+			lod.leafOrder.resize(lod.tree.lights.size());
+			for (size_t k = 0; k < lod.tree.lights.size(); k++) {
+				lod.leafOrder[k] = lod.candidates[lod.tree.lights[k]];
+			}
+			// Children come after their parent, and an inner node's second child is its first child's skip.
+			lod.nodeLights.resize(numNodes);
+			for (int32_t n = numNodes - 1; n >= 0; n--) {
+				if (nodes[n].count > 0) {
+					lod.nodeLights[n] = glm::ivec2(nodes[n].first, nodes[n].first + nodes[n].count);
+				}
+				else {
+					int32_t second = nodes[n + 1].skip;
+					lod.nodeLights[n] = glm::ivec2(lod.nodeLights[n + 1].x, lod.nodeLights[second].y);
+				}
+			}
+
+			int32_t n = 0;
+			while (n < numNodes) {
+				glm::ivec2 range = lod.nodeLights[n];
+				int32_t count = range.y - range.x;
+				AggregateLight aggregate;
+				if (count >= 2 && mergeLights(lights, emissions, &lod.leafOrder[range.x], count,
+					projScale, settings.errorBudget, aggregate)) {
+					aggregate.firstMember = (int32_t)lod.members.size();
+					aggregate.numMembers = count;
+					lod.members.insert(lod.members.end(), lod.leafOrder.begin() + range.x, lod.leafOrder.begin() + range.y);
+					for (int32_t k = range.x; k < range.y; k++) {
+						lod.merged[lod.leafOrder[k]] = 1;
+					}
+					lod.aggregates.push_back(aggregate);
+					n = nodes[n].skip;
+				}
+				else {
+					// Inner nodes descend into their first child; leaves move on to skip.
+					n++;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < lights.size(); i++) {
+			if (!lod.merged[i]) {
+				lod.exact.push_back((int32_t)i);
+			}
+		}
+	}
+
+	// The inclusive range of grid cells a light's sphere overlaps.
+	static void staticGridCellRange(const LightVolume& lv, const StaticLightGrid& grid, glm::ivec3& lo, glm::ivec3& hi) {
+		glm::vec3 cellMin = glm::floor((lv.position - lv.radius - grid.origin) / grid.cellSize);
+		glm::vec3 cellMax = glm::floor((lv.position + lv.radius - grid.origin) / grid.cellSize);
+		lo = glm::clamp(glm::ivec3(cellMin), glm::ivec3(0), grid.dims - 1);
+		hi = glm::clamp(glm::ivec3(cellMax), glm::ivec3(0), grid.dims - 1);
+	}
+
+	void buildStaticLightGrid(
+		const std::vector<LightVolume>& lights,
+		const StaticLightGridSettings& settings,
+		StaticLightGrid& grid
+	) {
+		grid.cells.clear();
+		grid.indices.clear();
+		grid.dims = glm::ivec3(0);
+
+		glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		bool any = false;
+		for (const LightVolume& lv : lights) {
+			if (std::isfinite(lv.radius)) {
+				boundsMin = glm::min(boundsMin, lv.position - lv.radius);
+				boundsMax = glm::max(boundsMax, lv.position + lv.radius);
+				any = true;
+			}
+		}
+		if (!any) {
+			return;
+		}
+
+		// Coarsen the cells until the grid fits in maxCells.
+		glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-4f));
+		float cellSize = std::max(settings.cellSize, 1e-4f);
+		double maxCells = (double)std::max(settings.maxCells, (size_t)1);
+		glm::ivec3 dims;
+		while (true) {
+			dims = glm::max(glm::ivec3(glm::ceil(extent / cellSize)), glm::ivec3(1));
+			double numCells = (double)dims.x * dims.y * dims.z;
+			if (numCells <= maxCells) {
+				break;
+			}
+			cellSize *= std::max((float)std::cbrt(numCells / maxCells), 1.01f);
+		}
+		grid.origin = boundsMin;
+		grid.cellSize = cellSize;
+		grid.dims = dims;
+		size_t numCells = (size_t)dims.x * dims.y * dims.z;
+		grid.cells.assign(2 * numCells, 0);
+
+		// Calls visit(cell) for every cell the light touches.
+		auto forEachCell = [&grid](const LightVolume& lv, auto&& visit) {
+			glm::ivec3 lo, hi;
+			staticGridCellRange(lv, grid, lo, hi);
+			for (int z = lo.z; z <= hi.z; z++) {
+				for (int y = lo.y; y <= hi.y; y++) {
+					for (int x = lo.x; x <= hi.x; x++) {
+						ClusterAABB cell;
+						cell.minPoint = glm::vec4(grid.origin + grid.cellSize * glm::vec3(x, y, z), 1.0f);
+						cell.maxPoint = glm::vec4(grid.origin + grid.cellSize * glm::vec3(x + 1, y + 1, z + 1), 1.0f);
+						if (lightTouchesCluster(lv, cell)) {
+							visit(x + grid.dims.x * (y + grid.dims.y * z));
+						}
+					}
+				}
+			}
+		};
+
+		// Count, prefix sum and fill, as in binLights(). The cells are found twice rather
+		// than stored, since the grid is rebuilt rarely and a light may cover many cells.
+		for (const LightVolume& lv : lights) {
+			if (std::isfinite(lv.radius)) {
+				forEachCell(lv, [&grid](int32_t c) { grid.cells[2 * c + 1]++; });
+			}
+		}
+		grid.cursor.resize(numCells);
+		int32_t total = 0;
+		for (size_t c = 0; c < numCells; c++) {
+			grid.cells[2 * c] = total;
+			grid.cursor[c] = total;
+			total += grid.cells[2 * c + 1];
+		}
+		grid.indices.resize(total);
+		for (size_t i = 0; i < lights.size(); i++) {
+			if (std::isfinite(lights[i].radius)) {
+				forEachCell(lights[i], [&grid, i](int32_t c) { grid.indices[grid.cursor[c]++] = (int32_t)i; });
+			}
+		}
+	}
+
+	// Appends the index of every cluster the light touches to cells.
+	static void findLightClusters(
+		const LightVolume& lv,
+		const std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		glm::vec2 projScale,
+		const DepthSlicing& slicing,
+		std::vector<int32_t>& cells
+	) {
+		LightClusterRange range;
+		if (!lightClusterRange(lv, numTiles, projScale, slicing, range)) {
+			return;
+		}
+		bool bounded = std::isfinite(lv.radius);
+		for (int z = range.min.z; z <= range.max.z; z++) {
+			for (int y = range.min.y; y <= range.max.y; y++) {
+				for (int x = range.min.x; x <= range.max.x; x++) {
+					int32_t c = x + numTiles.x * (y + numTiles.y * z);
+					if (bounded && !lightTouchesCluster(lv, clusters[c])) {
+						continue;
+					}
+					cells.push_back(c);
+				}
+			}
+		}
+	}
+
+	void binLights(
+		const std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		BinningScratch& scratch,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		size_t numClusters = (size_t)numTiles.x * numTiles.y * numTiles.z;
+		tileLightMapping.assign(2 * numClusters, 0);
+		scratch.cells.clear();
+		scratch.lightOfCell.clear();
+
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+
+		// Pass 1: find every cluster each light covers, and count per cluster.
+		for (size_t i = 0; i < lights.size(); i++) {
+			size_t first = scratch.cells.size();
+			findLightClusters(lights[i], clusters, numTiles, projScale, slicing, scratch.cells);
+			for (size_t k = first; k < scratch.cells.size(); k++) {
+				scratch.lightOfCell.push_back((int32_t)i);
+				tileLightMapping[2 * scratch.cells[k] + 1]++;
+			}
+		}
+
+		// Pass 2: exclusive prefix sum of the counts gives each cluster's offset.
+		scratch.cursor.resize(numClusters);
+		int32_t total = 0;
+		for (size_t c = 0; c < numClusters; c++) {
+			tileLightMapping[2 * c] = total;
+			scratch.cursor[c] = total;
+			total += tileLightMapping[2 * c + 1];
+		}
+
+		// Pass 3: scatter. Entries are grouped by light in index order, so each
+		// cluster's list comes out sorted.
+		lightsIndex.resize(total);
+		for (size_t k = 0; k < scratch.cells.size(); k++) {
+			lightsIndex[scratch.cursor[scratch.cells[k]]++] = scratch.lightOfCell[k];
+		}
+	}
+
+	void binLightsIncremental(
+		const std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		float margin,
+		IncrementalBinning& state,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	) {
+		size_t numClusters = (size_t)numTiles.x * numTiles.y * numTiles.z;
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+
+		// The stored cells are only valid for the grid they were binned into.
+		bool rebuild = state.numTiles != numTiles || state.projMatrix != projMatrix ||
+			state.slicing != slicing || state.binned.size() != lights.size();
+
+		// A light keeps its cells while its sphere stays inside the (enlarged) sphere it
+		// was binned with. Cones aren't enlarged, so spot lights are re-binned every frame.
+		state.stale.clear();
+		for (size_t i = 0; i < lights.size() && !rebuild; i++) {
+			const LightVolume& lv = lights[i];
+			const LightVolume& old = state.binned[i];
+			bool keep = std::isfinite(lv.radius) ?
+				lv.coneRange <= 0.0f && glm::length(lv.position - old.position) + lv.radius <= old.radius :
+				!std::isfinite(old.radius);
+			if (!keep) {
+				state.stale.push_back((int32_t)i);
+			}
+		}
+		// Large camera motion moves most lights; start over so every margin is fresh.
+		if (rebuild || 2 * state.stale.size() > lights.size()) {
+			rebuild = true;
+			state.numTiles = numTiles;
+			state.projMatrix = projMatrix;
+			state.slicing = slicing;
+			state.binned.resize(lights.size());
+			state.cellsOfLight.resize(lights.size());
+			state.stale.resize(lights.size());
+			for (size_t i = 0; i < lights.size(); i++) {
+				state.stale[i] = (int32_t)i;
+			}
+		}
+		state.lastRebinned = state.stale.size();
+		state.lastFullRebuild = rebuild;
+
+		for (int32_t i : state.stale) {
+			LightVolume lv = lights[i];
+			if (std::isfinite(lv.radius) && lv.coneRange <= 0.0f) {
+				lv.radius *= 1.0f + margin;
+			}
+			state.binned[i] = lv;
+			state.cellsOfLight[i].clear();
+			findLightClusters(lv, clusters, numTiles, projScale, slicing, state.cellsOfLight[i]);
+		}
+
+		// Rebuild the lists from the per-light cells, same as binLights() passes 2 and 3.
+		tileLightMapping.assign(2 * numClusters, 0);
+		for (const std::vector<int32_t>& cells : state.cellsOfLight) {
+			for (int32_t c : cells) {
+				tileLightMapping[2 * c + 1]++;
+			}
+		}
+		state.cursor.resize(numClusters);
+		int32_t total = 0;
+		for (size_t c = 0; c < numClusters; c++) {
+			tileLightMapping[2 * c] = total;
+			state.cursor[c] = total;
+			total += tileLightMapping[2 * c + 1];
+		}
+		lightsIndex.resize(total);
+		for (size_t i = 0; i < state.cellsOfLight.size(); i++) {
+			for (int32_t c : state.cellsOfLight[i]) {
+				lightsIndex[state.cursor[c]++] = (int32_t)i;
+			}
+		}
+	}
+
+
+
+	void remapIncrementalBinning(IncrementalBinning& state, const std::vector<int32_t>& newIndexOfOld) {
+		if (state.binned.size() != newIndexOfOld.size()) {
+			state.binned.clear();		// Forces a full rebuild.
+			return;
+		}
+		std::vector<LightVolume> binned(state.binned.size());
+		std::vector<std::vector<int32_t>> cellsOfLight(state.cellsOfLight.size());
+		for (size_t i = 0; i < newIndexOfOld.size(); i++) {
+			binned[newIndexOfOld[i]] = state.binned[i];
+			cellsOfLight[newIndexOfOld[i]].swap(state.cellsOfLight[i]);
+		}
+		state.binned.swap(binned);
+		state.cellsOfLight.swap(cellsOfLight);
+	}
+
+	void buildZBins(
+		const std::vector<LightVolume>& lights,
+		glm::ivec3 numTiles,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		ZBins& zbins
+	) {
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		float zNear = slicing.zNear;
+		float zFar = slicing.zFar;
+		size_t numLights = lights.size();
+		size_t numTiles2D = (size_t)numTiles.x * numTiles.y;
+
+		// Sort by nearest depth. Unbounded lights go first and lights that can't
+		// be seen go last, which keeps the per-slice index ranges tight.
+		zbins.sortKeys.resize(numLights);
+		for (size_t i = 0; i < numLights; i++) {
+			const LightVolume& lv = lights[i];
+			float depth = -lv.position.z;
+			if (!std::isfinite(lv.radius))
+				zbins.sortKeys[i] = -inf;
+			else if (depth + lv.radius < zNear || depth - lv.radius > zFar)
+				zbins.sortKeys[i] = inf;
+			else
+				zbins.sortKeys[i] = depth - lv.radius;
+		}
+		zbins.order.resize(numLights);
+		for (size_t i = 0; i < numLights; i++) {
+			zbins.order[i] = (int32_t)i;
+		}
+		std::stable_sort(zbins.order.begin(), zbins.order.end(), [&](int32_t a, int32_t b) {
+			return zbins.sortKeys[a] < zbins.sortKeys[b];
+		});
+
+		zbins.bins.resize(2 * (size_t)numTiles.z);
+		for (int z = 0; z < numTiles.z; z++) {
+			zbins.bins[2 * z] = (int32_t)numLights;
+			zbins.bins[2 * z + 1] = -1;
+		}
+		zbins.wordsPerTile = (int32_t)((numLights + 31) / 32);
+		zbins.tileMasks.assign(numTiles2D * zbins.wordsPerTile, 0u);
+
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+
+		for (size_t k = 0; k < numLights; k++) {
+			const LightVolume& lv = lights[zbins.order[k]];
+			if (zbins.sortKeys[zbins.order[k]] == inf) {
+				break;		// Everything from here on is outside [zNear, zFar].
+			}
+			glm::ivec3 lo = glm::ivec3(0);
+			glm::ivec3 hi = numTiles - 1;
+			if (std::isfinite(lv.radius)) {
+				glm::vec4 rect;
+				glm::vec2 depthRange;
+				projectSphere(lv.position, lv.radius, projScale, zNear, zFar, rect, depthRange);
+				if (rect.z <= 0.0f || rect.x >= 1.0f || rect.w <= 0.0f || rect.y >= 1.0f) {
+					continue;
+				}
+				lo.x = (int)std::floor(std::max(rect.x, 0.0f) * numTiles.x);
+				lo.y = (int)std::floor(std::max(rect.y, 0.0f) * numTiles.y);
+				hi.x = (int)std::ceil(std::min(rect.z, 1.0f) * numTiles.x) - 1;
+				hi.y = (int)std::ceil(std::min(rect.w, 1.0f) * numTiles.y) - 1;
+				lo.z = slicing.slice(depthRange.x);
+				hi.z = slicing.slice(depthRange.y);
+			}
+
+			// k only increases, so the first light to touch a slice is its minimum.
+			for (int z = lo.z; z <= hi.z; z++) {
+				zbins.bins[2 * z] = std::min(zbins.bins[2 * z], (int32_t)k);
+				zbins.bins[2 * z + 1] = (int32_t)k;
+			}
+			uint32_t bit = 1u << (k % 32);
+			size_t word = k / 32;
+			for (int y = lo.y; y <= hi.y; y++) {
+				for (int x = lo.x; x <= hi.x; x++) {
+					zbins.tileMasks[((size_t)y * numTiles.x + x) * zbins.wordsPerTile + word] |= bit;
+				}
+			}
+		}
+	}
+
+
+
+	void gatherListStats(
+		const std::vector<int32_t>& tileLightMapping,
+		const std::vector<int32_t>& lightsIndex,
+		size_t numClusters,
+		size_t numLights,
+		bool bitset,
+		uint32_t budget,
+		CullingStatsRaw& raw
+	) {
+		size_t numWords = bitsetWords(numLights);
+		for (size_t c = 0; c < numClusters; c++) {
+			uint32_t count = 0;
+			if (bitset) {
+				for (size_t w = 0; w < numWords; w++) {
+					uint32_t bits = (uint32_t)lightsIndex[c * numWords + w];
+					// Portable popcount; this only runs when stats are enabled.
+					for (; bits != 0; bits &= bits - 1)
+						count++;
+				}
+			}
+			else {
+				count = (uint32_t)tileLightMapping[2 * c + 1];
+			}
+			raw.histogram[std::min((size_t)count, statsHistogramSize - 1)]++;
+			raw.maxLights = std::max(raw.maxLights, count);
+			raw.totalIndices += count;
+			if (count > budget)
+				raw.overBudgetClusters++;
+		}
+	}
+
+	CullingStats summarizeCullingStats(const CullingStatsRaw& raw, int64_t frame) {
+		CullingStats stats;
+		stats.frame = frame;
+		for (size_t i = 0; i < statsHistogramSize; i++) {
+			stats.numClusters += raw.histogram[i];
+		}
+		stats.emptyClusters = raw.histogram[0];
+		stats.overflowingClusters = raw.overflowingClusters;
+		stats.overBudgetClusters = raw.overBudgetClusters;
+		stats.maxLights = raw.maxLights;
+		stats.totalIndices = raw.totalIndices;
+		if (stats.numClusters > 0) {
+			stats.meanLights = raw.totalIndices / (float)stats.numClusters;
+			// Smallest count with at least 99% of clusters at or below it.
+			uint64_t threshold = ((uint64_t)stats.numClusters * 99 + 99) / 100;
+			uint64_t seen = 0;
+			for (size_t i = 0; i < statsHistogramSize; i++) {
+				seen += raw.histogram[i];
+				if (seen >= threshold) {
+					stats.p99Lights = (uint32_t)i;
+					break;
+				}
+			}
+		}
+		return stats;
+	}
+
+
+	size_t countFalsePositives(
+		Utils::ThreadPool& pool,
+		const std::vector<int32_t>& tileLightMapping,
+		const std::vector<int32_t>& lightsIndex,
+		glm::ivec3 numTiles,
+		glm::ivec2 viewportSize,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing
+	) {
+		size_t numClusters = std::min((size_t)numTiles.x * numTiles.y * numTiles.z, tileLightMapping.size() / 2);
+		if (numClusters == 0) {
+			return 0;
+		}
+		glm::vec2 projScale = glm::vec2(projMatrix[0][0], projMatrix[1][1]);
+		glm::vec2 tileSize = glm::vec2(viewportSize) / glm::vec2(numTiles);
+
+		size_t chunkSize = std::max(numClusters / (4 * pool.getNumThreads()), (size_t)1);
+		std::vector<size_t> chunkCounts((numClusters + chunkSize - 1) / chunkSize, 0);
+		pool.parallelFor(numClusters, chunkSize, [&](size_t begin, size_t end) {
+			size_t falsePositives = 0;
+			for (size_t c = begin; c < end; c++) {
+				int x = (int)(c % numTiles.x);
+				int y = (int)(c / numTiles.x % numTiles.y);
+				int z = (int)(c / ((size_t)numTiles.x * numTiles.y));
+				float sliceNear = slicing.sliceNear(z);
+				float sliceFar = slicing.sliceNear(z + 1);
+				// Pixels whose centers fall in the tile.
+				glm::ivec2 pixelBegin = glm::ivec2(glm::ceil(glm::vec2(x, y) * tileSize - 0.5f));
+				glm::ivec2 pixelEnd = glm::ivec2(glm::ceil(glm::vec2(x + 1, y + 1) * tileSize - 0.5f));
+
+				int32_t offset = tileLightMapping[2 * c];
+				int32_t count = tileLightMapping[2 * c + 1];
+				for (int32_t k = offset; k < offset + count; k++) {
+					const LightVolume& lv = lights[lightsIndex[k]];
+					if (!std::isfinite(lv.radius)) {
+						continue;
+					}
+					float cc = glm::dot(lv.position, lv.position) - lv.radius * lv.radius;
+					bool hit = false;
+					for (int py = pixelBegin.y; py < pixelEnd.y && !hit; py++) {
+						for (int px = pixelBegin.x; px < pixelEnd.x && !hit; px++) {
+							// View ray through the pixel center, scaled to unit depth.
+							glm::vec2 ndc = (glm::vec2(px, py) + 0.5f) / glm::vec2(viewportSize) * 2.0f - 1.0f;
+							glm::vec3 dir = glm::vec3(ndc / projScale, -1.0f);
+							float a = glm::dot(dir, dir);
+							float b = glm::dot(dir, lv.position);
+							float disc = b * b - a * cc;
+							if (disc < 0.0f) {
+								continue;
+							}
+							float root = std::sqrt(disc);
+							float enter = std::max((b - root) / a, sliceNear);
+							float exit = std::min((b + root) / a, sliceFar);
+							hit = enter <= exit;
+							if (hit && lv.coneRange > 0.0f) {
+								// Spot lights: sample the segment inside the sphere against the cone.
+								hit = false;
+								for (int s = 0; s < 16 && !hit; s++) {
+									glm::vec3 p = dir * (enter + (exit - enter) * (s + 0.5f) / 16.0f) - lv.coneApex;
+									float dist = glm::length(p);
+									hit = dist <= lv.coneRange && glm::dot(p, lv.coneAxis) >= lv.coneCos * dist;
+								}
+							}
+						}
+					}
+					falsePositives += (size_t)!hit;
+				}
+			}
+			chunkCounts[begin / chunkSize] = falsePositives;
+		});
+
+		size_t total = 0;
+		for (size_t n : chunkCounts) {
+			total += n;
+		}
+		return total;
+	}
+
+}
\ No newline at end of file
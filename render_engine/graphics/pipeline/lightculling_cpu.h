@@ -0,0 +1,656 @@
+#pragma once
+#include "utils/threadpool.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class GO_Light;
+
+
+/*
+* CPU light culling shared by the forward and deferred OpenGL pipelines.
+* Everything here works on plain view-space data and writes the same layout the
+* GPU cullers produce, so the results can be copied straight into the SSBOs:
+*	tileLightMapping: 2 ints per cluster (offset into lightsIndex, count)
+*	lightsIndex: compact list of light indices
+* It depends on nothing but glm and Utils::ThreadPool, and is also built on its own
+* as the lightculling static library (see lightculling_bench). gatherLightVolumes(),
+* which reads GO_Lights, lives in lightculling_scene.cpp and is engine-only.
+*/
+namespace LightCullingCPU {
+
+	// Must match VolumeTileAABB in clusterscull3.glsl and clustersbvh.glsl.
+	struct ClusterAABB {
+		glm::vec4 minPoint;
+		glm::vec4 maxPoint;
+	};
+
+	// A view-space bounding sphere. Lights with no bounded influence (directional
+	// lights) get an infinite radius and so land in every cluster. Spot lights also
+	// carry their cone, which clusters inside the sphere are tested against too.
+	struct LightVolume {
+		glm::vec3 position;
+		float radius;
+		// Spot lights with an outer angle below 90 degrees only (coneRange > 0).
+		glm::vec3 coneApex = glm::vec3(0.0f);
+		glm::vec3 coneAxis = glm::vec3(0.0f);	// Normalized.
+		float coneRange = 0.0f;
+		float coneSin = 0.0f;					// Of the outer half-angle.
+		float coneCos = 0.0f;
+	};
+
+	/*
+	* How the view depth range [zNear, zFar] is cut into the cluster grid's depth slices:
+	* linearSlices equal slices from zNear to split, then exponential slices from split
+	* to end, with the last slice stretched to zFar. Every DepthSlicingMode reduces to
+	* this, so the CPU cullers and the shaders (depthSlice() and sliceNear(), fed
+	* packed() as the depthSlicing uniform) share one definition.
+	*/
+	struct DepthSlicing {
+		int numSlices = 1;
+		float zNear = 0.1f;
+		float zFar = 100.0f;
+		int linearSlices = 0;
+		float split = 0.1f;		// zNear when there are no linear slices.
+		float end = 100.0f;		// zFar, except for DepthSlicingMode::Adaptive.
+
+		// The slice a view depth falls in, clamped to [0, numSlices - 1].
+		int slice(float depth) const;
+		// The near depth of slice k. sliceNear(numSlices) is zFar.
+		float sliceNear(int k) const;
+		// (linearSlices, split, end, 0), for the depthSlicing uniform.
+		glm::vec4 packed() const;
+
+		bool operator==(const DepthSlicing& other) const;
+		bool operator!=(const DepthSlicing& other) const { return !(*this == other); }
+	};
+
+	enum class DepthSlicingMode {
+		Exponential,	// zNear * (zFar / zNear)^(k / N). Thin slices near the camera.
+		Linear,			// Equal thickness.
+		Hybrid,			// Linear up to a split depth, exponential after it.
+		Adaptive,		// Exponential over the scene depth range measured on an earlier frame.
+	};
+
+	/*
+	* Hybrid: the number of linear slices is chosen so their thickness is closest to
+	* that of the first exponential slice after splitDepth.
+	* Adaptive: one slice from zNear to measuredRange.x, then exponential slices up to
+	* measuredRange.y, and the last slice stretched to zFar. The range is rounded outwards
+	* (to 1/8 of an octave) so small changes don't move the slices every frame; without a
+	* usable range (e.g. (0, 0) before the first measurement) this is Exponential.
+	*/
+	DepthSlicing makeDepthSlicing(
+		DepthSlicingMode mode,
+		int numSlices,
+		float zNear,
+		float zFar,
+		float splitDepth,
+		glm::vec2 measuredRange
+	);
+
+	/*
+	* Computes the view-space AABB of every cluster. Index = x + y*X + z*X*Y.
+	* slicing.numSlices must be numTiles.z.
+	*/
+	void computeClusterAABBs(
+		std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const glm::mat4& inverseProjection,
+		const DepthSlicing& slicing
+	);
+
+	/*
+	* A hash of everything computeClusterAABBs() depends on: the grid resolution, the
+	* projection (FOV, aspect and near/far) and the depth slicing. Rebuild the AABBs
+	* when it changes.
+	*/
+	uint64_t clusterGridKey(
+		glm::ivec3 numTiles,
+		const glm::mat4& projection,
+		const DepthSlicing& slicing
+	);
+
+	/*
+	* Fills volumes with the view-space bounding volume of each light, in the same
+	* order as the input (and hence as lightsSSBO). Engine-only (lightculling_scene.cpp).
+	*/
+	void gatherLightVolumes(
+		std::vector<LightVolume>& volumes,
+		const std::vector<GO_Light*>& lights,
+		const glm::mat4& viewMatrix
+	);
+
+	/*
+	* Exact screen bounds of a view-space sphere under a symmetric perspective
+	* projection (projScale = (proj[0][0], proj[1][1])). Each axis is bounded by the
+	* lines through the eye that are tangent to the sphere; where a tangent point is
+	* closer than the near plane, the sphere's cap on the near plane bounds that side
+	* instead. rect is (left, bottom, right, top) in [0,1] screen space and depthRange
+	* the visible (near, far) view depth. Returns false if the sphere is entirely
+	* outside [zNear, zFar]. Mirrored by projectSphere() in clusterscull3.glsl.
+	*/
+	bool projectSphere(
+		glm::vec3 center,
+		float radius,
+		glm::vec2 projScale,
+		float zNear,
+		float zFar,
+		glm::vec4& rect,
+		glm::vec2& depthRange
+	);
+
+	/*
+	* Screen-space light rectangles in structure-of-arrays form, used by the tiled
+	* culler. Coordinates are in [0,1] screen space (same as the tile bounds).
+	* The arrays are padded to simdWidth with empty rectangles so the kernels never
+	* need a scalar tail loop.
+	*/
+	constexpr size_t simdWidth = 8;
+	struct LightRectsSoA {
+		std::vector<float> minX;
+		std::vector<float> minY;
+		std::vector<float> maxX;
+		std::vector<float> maxY;
+		size_t count = 0;			// Number of real lights.
+		size_t paddedCount = 0;		// count rounded up to simdWidth.
+	};
+
+	/*
+	* Projects each light's bounding sphere to a screen rectangle (see projectSphere())
+	* once per frame, so the per-tile test is just 4 comparisons. Lights entirely
+	* outside [zNear, zFar] get an empty rectangle; unbounded (directional) lights cover
+	* the whole screen.
+	*/
+	void gatherLightRects(
+		LightRectsSoA& rects,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		float zNear,
+		float zFar
+	);
+
+	enum class SIMDLevel {
+		Scalar = 0,
+		SSE4 = 1,
+		AVX2 = 2,
+	};
+
+	/*
+	* The kernel used by cullLightRects(). Defaults to the best level the CPU
+	* supports; setSIMDLevel() can lower it (e.g. for benchmarking) but never raise
+	* it above what was detected.
+	*/
+	SIMDLevel getSIMDLevel();
+	void setSIMDLevel(SIMDLevel level);
+
+	/*
+	* Writes the indices of all lights whose rectangle overlaps the tile
+	* (left, bottom, right, top) to out, and returns how many were written.
+	* out must have room for rects.paddedCount + simdWidth ints, since the vector
+	* kernels store whole registers and only advance by the number of survivors.
+	*/
+	size_t cullLightRects(const LightRectsSoA& rects, glm::vec4 tileBounds, int32_t* out);
+
+	/*
+	* The tiled culler: cullLightRects() for every tile of a numTiles grid, appended
+	* in tile order (x + y*X). tileLights is scratch for the kernels.
+	*/
+	void cullTiles(
+		const LightRectsSoA& rects,
+		glm::ivec2 numTiles,
+		std::vector<int32_t>& tileLights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* Tests every light against every cluster AABB and writes the compact light lists.
+	* Clusters are split into contiguous chunks that run on the worker pool; each chunk
+	* builds its own list and the lists are stitched together afterwards, so the output
+	* is identical to a serial run.
+	*/
+	void cullClusters(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* Brute-force references for validating the other cullers: every (tile/cluster, light)
+	* pair is tested one at a time on the calling thread, with the same tests as
+	* cullTiles() and cullClusters(), and the same output layout. Far too slow for frames.
+	*/
+	void cullTilesReference(
+		const LightRectsSoA& rects,
+		glm::ivec2 numTiles,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+	void cullClustersReference(
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* Bitset light lists: instead of (offset, count) + index list, every cluster gets
+	* one bit per light, plus a summary word per 32 bit words so empty groups of 32
+	* lights can be skipped. Both are stored at a fixed stride per cluster:
+	*	summary: bitsetSummaryWords() words per cluster (bit w set if bits word w != 0)
+	*	bits: bitsetWords() words per cluster (bit i set if light i touches the cluster)
+	* No counting or stitching is needed, so every cluster is written independently.
+	*/
+	inline size_t bitsetWords(size_t numLights) {
+		return (numLights + 31) / 32;
+	}
+	inline size_t bitsetSummaryWords(size_t numLights) {
+		return (bitsetWords(numLights) + 31) / 32;
+	}
+
+	void cullClustersBitset(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		std::vector<int32_t>& summary,
+		std::vector<int32_t>& bits
+	);
+
+	/*
+	* Stable LSD radix sort of keys by their upper 32 bits, 8 bits per pass. Each pass
+	* counts and scatters contiguous chunks of the keys on the pool. scratch is resized
+	* as needed and its contents are left unspecified.
+	*/
+	void radixSortKeys(
+		Utils::ThreadPool& pool,
+		std::vector<uint64_t>& keys,
+		std::vector<uint64_t>& scratch
+	);
+
+	/*
+	* Scratch buffers for mortonOrder(), kept by the caller so they are reused between frames.
+	*/
+	struct MortonScratch {
+		std::vector<uint64_t> keys;
+		std::vector<uint64_t> sortScratch;
+	};
+
+	/*
+	* Orders points along a Morton curve through their bounding box, 10 bits per axis:
+	* order[k] is the index of the k-th point on the curve. Points that are close in the
+	* order are close in space, so lights stored in this order give each cluster's list
+	* nearby indices. Ties keep their input order.
+	*/
+	void mortonOrder(
+		Utils::ThreadPool& pool,
+		const std::vector<glm::vec3>& points,
+		std::vector<int32_t>& order,
+		MortonScratch& scratch
+	);
+
+	/*
+	* Bounding volume hierarchy over the light spheres, for light counts where testing
+	* every light against every cluster stops scaling. Nodes are stored depth-first: an
+	* inner node's first child is the next node, and skip is the node after its subtree,
+	* so traversal needs no stack. Must match LightBVHNode in clustersbvh.glsl.
+	*/
+	struct LightBVHNode {
+		glm::vec4 boundsMin;		// xyz: AABB of the spheres below this node.
+		glm::vec4 boundsMax;
+		int32_t first;				// Leaves: first entry in LightBVH::lights.
+		int32_t count;				// Leaves: number of lights. 0 for inner nodes.
+		int32_t skip;				// Next node to visit once this subtree is done or rejected.
+		int32_t pad;
+	};
+	constexpr int32_t lightBVHLeafSize = 4;
+
+	struct LightBVH {
+		std::vector<LightBVHNode> nodes;
+		std::vector<int32_t> lights;		// Light indices in leaf order.
+		std::vector<int32_t> unbounded;		// Lights with an infinite radius, which aren't in the tree.
+		std::vector<uint64_t> keys;			// Scratch: (Morton code << 32) | light index.
+		std::vector<uint64_t> sortScratch;	// Scratch for radixSortKeys().
+	};
+
+	/*
+	* Rebuilds the BVH from scratch (an LBVH). Lights are sorted along a Morton curve
+	* through their view-space centers (see mortonOrder()), and each sorted range is
+	* split where its highest differing Morton bit flips. Linear in the number of lights
+	* apart from the sort. View-space bounds change with the camera, so this runs every frame.
+	*/
+	void buildLightBVH(
+		Utils::ThreadPool& pool,
+		const std::vector<LightVolume>& lights,
+		LightBVH& bvh
+	);
+
+	/*
+	* cullClusters() with each cluster walking the BVH instead of testing every light,
+	* so a cluster only tests the lights in the leaves whose bounds it overlaps. Same
+	* output layout; each cluster's lights come out in BVH order rather than index order.
+	*/
+	void cullClustersBVH(
+		Utils::ThreadPool& pool,
+		const std::vector<ClusterAABB>& clusters,
+		const std::vector<LightVolume>& lights,
+		const LightBVH& bvh,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* Scratch buffers for binLights(), kept by the caller so they are reused between frames.
+	*/
+	struct BinningScratch {
+		std::vector<int32_t> cells;			// Covered cell indices, grouped by light.
+		std::vector<int32_t> lightOfCell;	// The light each entry in cells belongs to.
+		std::vector<int32_t> cursor;		// Per-cell write position during the fill pass.
+	};
+
+	/*
+	* Rasterized light binning. Instead of testing every (cluster, light) pair, each
+	* light's sphere is projected once to a conservative tile rectangle and depth-slice
+	* range, and only the clusters inside that range are visited (and refined with the
+	* sphere-vs-AABB test). The lists are then built with a count pass, a prefix sum
+	* and a fill pass, so lightsIndex stays compact and each cluster's lights stay in
+	* index order. Cost is O(lights + covered clusters) rather than O(clusters * lights).
+	* Works for tiles too (numTiles.z == 1).
+	*/
+	void binLights(
+		const std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		BinningScratch& scratch,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* State kept between frames by binLightsIncremental().
+	*/
+	struct IncrementalBinning {
+		std::vector<LightVolume> binned;				// The (enlarged) volume each light was last binned with.
+		std::vector<std::vector<int32_t>> cellsOfLight;	// The clusters each light was last binned into.
+		glm::ivec3 numTiles = glm::ivec3(0);			// The grid the cells belong to.
+		glm::mat4 projMatrix = glm::mat4(0.0f);
+		DepthSlicing slicing;
+		size_t lastRebinned = 0;						// Lights re-binned by the last call.
+		bool lastFullRebuild = false;
+		std::vector<int32_t> stale;						// Scratch.
+		std::vector<int32_t> cursor;					// Scratch.
+	};
+
+	/*
+	* binLights() that reuses the previous frame's work. Each light is binned with its
+	* radius enlarged by margin (a fraction of the radius) and keeps those clusters
+	* until its view-space sphere leaves the enlarged one. Only the lights that did are
+	* re-binned; the lists are then rebuilt from the per-light clusters, which is much
+	* cheaper than finding them. Grid or projection changes, a change in the number of
+	* lights, or camera motion large enough to invalidate over half of the lights
+	* re-bin everything. The lists are a superset of binLights()' (by the margin).
+	*/
+	void binLightsIncremental(
+		const std::vector<ClusterAABB>& clusters,
+		glm::ivec3 numTiles,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		float margin,
+		IncrementalBinning& state,
+		std::vector<int32_t>& tileLightMapping,
+		std::vector<int32_t>& lightsIndex
+	);
+
+	/*
+	* Carries binLightsIncremental() state over to a new light order, where
+	* newIndexOfOld[i] is the new index of the light that was at index i. If the number
+	* of lights changed, the state is dropped and the next call re-bins everything.
+	*/
+	void remapIncrementalBinning(IncrementalBinning& state, const std::vector<int32_t>& newIndexOfOld);
+
+
+	/*
+	* The inclusive range of clusters a light can touch: its conservative tile rectangle
+	* (from projectSphere()) and depth-slice range, the same cells binLights() visits.
+	* Layout must match lightRanges in clusterscull3.glsl.
+	*/
+	struct LightClusterRange {
+		glm::ivec4 min;		// (x, y, z, unused)
+		glm::ivec4 max;
+	};
+
+	/*
+	* Fills range for one light. Returns false if the light's sphere is outside the
+	* view frustum and so touches no cluster. Lights without a bounded volume (infinite
+	* radius) cover the whole grid.
+	*/
+	bool lightClusterRange(
+		const LightVolume& lv,
+		glm::ivec3 numTiles,
+		glm::vec2 projScale,
+		const DepthSlicing& slicing,
+		LightClusterRange& range
+	);
+
+	/*
+	* Frustum pre-cull for the GPU culler: keeps the lights whose bounding sphere is in
+	* the view frustum and computes each one's cluster range. visible[k] is the index of
+	* the k-th surviving light in lights (in input order) and ranges[k] is its range.
+	*/
+	void preCullLights(
+		const std::vector<LightVolume>& lights,
+		glm::ivec3 numTiles,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		std::vector<int32_t>& visible,
+		std::vector<LightClusterRange>& ranges
+	);
+
+
+	// The intensity aggregate lights' ranges are measured to (the default GO_Light::cutoff).
+	constexpr float lightRangeThreshold = 0.02f;
+
+	// What a point light emits, as the shaders see it (quadratic attenuation only).
+	// Lights with a quadratic of 0 are never merged.
+	struct LightEmission {
+		glm::vec3 color;
+		float quadratic;
+	};
+
+	struct LightLODSettings {
+		// Point lights whose bounding sphere spans less than this fraction of the viewport
+		// height may be merged.
+		float screenSize = 0.1f;
+		// The furthest a merged light may move on screen, as a fraction of the viewport height.
+		float errorBudget = 0.01f;
+	};
+
+	// A point light standing in for several far-away ones.
+	struct AggregateLight {
+		LightVolume volume;			// At the members' weighted center; radius is its range.
+		LightEmission emission;
+		int32_t firstMember;		// In LightLOD::members.
+		int32_t numMembers;
+	};
+
+	struct LightLOD {
+		std::vector<int32_t> exact;				// Lights kept as they are, in input order.
+		std::vector<AggregateLight> aggregates;
+		std::vector<int32_t> members;			// The lights each aggregate replaces.
+		// Scratch.
+		std::vector<int32_t> candidates;
+		std::vector<LightVolume> candidateVolumes;
+		LightBVH tree;
+		std::vector<int32_t> leafOrder;			// Input indices of the candidates in tree order.
+		std::vector<glm::ivec2> nodeLights;		// Each node's range in leafOrder.
+		std::vector<uint8_t> merged;
+	};
+
+	/*
+	* Light level of detail. The point lights that are small on screen (settings.screenSize)
+	* are put in a BVH (buildLightBVH()), which is cut top-down: each subtree whose lights
+	* can be replaced by a single point light becomes one aggregate, and the lights of the
+	* leaves that can't stay exact, as do spot lights and everything near the camera.
+	*
+	* An aggregate sits at the center of its members weighted by their far-field intensity
+	* (color / quadratic attenuation), and emits their summed far-field intensity, so it
+	* matches them exactly far away. A subtree is merged only if every member stays within
+	* settings.errorBudget of the aggregate on screen and inside the aggregate's range,
+	* so no pixel a member lit drops out of the aggregate's clusters.
+	*/
+	void buildLightLOD(
+		Utils::ThreadPool& pool,
+		const std::vector<LightVolume>& lights,
+		const std::vector<LightEmission>& emissions,
+		const glm::mat4& projMatrix,
+		const LightLODSettings& settings,
+		LightLOD& lod
+	);
+
+
+	struct StaticLightGridSettings {
+		// Edge length of a cell, in world units. Grown if the grid would have more than maxCells.
+		float cellSize = 1.0f;
+		size_t maxCells = 1 << 18;
+	};
+
+	/*
+	* A fixed-size world-space grid over lights that never move, built once instead of
+	* every frame. It spans the bounds of the lights' spheres (nothing outside them is lit
+	* by any of these lights) and uses the same layout as the view-space lists:
+	*	cells: 2 ints per cell (offset into indices, count), cell x + y*X + z*X*Y
+	*	indices: compact list of light indices, sorted within each cell
+	* The shaders find a fragment's cell from its world position (staticLightGrid in
+	* forward.frag and deferred_light.frag).
+	*/
+	struct StaticLightGrid {
+		glm::vec3 origin = glm::vec3(0.0f);		// Min corner of cell (0, 0, 0).
+		float cellSize = 1.0f;
+		glm::ivec3 dims = glm::ivec3(0);		// (0, 0, 0) when there are no lights.
+		std::vector<int32_t> cells;
+		std::vector<int32_t> indices;
+		std::vector<int32_t> cursor;			// Scratch.
+	};
+
+	/*
+	* Bins world-space light volumes (gatherLightVolumes() with an identity view matrix)
+	* into grid, with the same sphere-vs-AABB and cone tests as the clusters. Lights with
+	* an infinite radius are skipped; they belong with the per-frame lights.
+	*/
+	void buildStaticLightGrid(
+		const std::vector<LightVolume>& lights,
+		const StaticLightGridSettings& settings,
+		StaticLightGrid& grid
+	);
+
+
+	/*
+	* Z-binned light lists. Rather than a list per cluster, lights are sorted by the
+	* near edge of their bounding sphere, and two much smaller structures are built:
+	*	bins: 2 ints per depth slice, the first and last sorted light touching it
+	*	tileMasks: wordsPerTile words per screen tile, bit k set if sorted light k touches it
+	* The shader takes the bin's index range and walks only those bits of its tile's
+	* mask. Memory is O(slices + tiles * lights / 32) and there is no per-cluster cap.
+	* Depth slices follow the DepthSlicing, same as the clusters.
+	*/
+	struct ZBins {
+		std::vector<int32_t> order;			// order[k] = index (into the input) of the k-th sorted light.
+		std::vector<int32_t> bins;			// (first, last) per slice; first > last when empty.
+		std::vector<uint32_t> tileMasks;
+		int32_t wordsPerTile = 0;			// (number of lights + 31) / 32.
+		std::vector<float> sortKeys;		// Scratch.
+	};
+
+	/*
+	* Sorts the lights and fills zbins. The caller must upload the lights in
+	* zbins.order so that bit k refers to light k in lightsSSBO.
+	* numTiles.z is the number of depth slices.
+	*/
+	void buildZBins(
+		const std::vector<LightVolume>& lights,
+		glm::ivec3 numTiles,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing,
+		ZBins& zbins
+	);
+
+
+	/*
+	* Per-frame statistics about the light lists, used to size the cluster grid.
+	* The CPU cullers and clustersstats.glsl both fill CullingStatsRaw (a histogram of
+	* lights per cluster plus a few totals) and summarizeCullingStats() derives the rest.
+	* Counts of statsHistogramSize - 1 or more share the last bin, so p99 saturates there.
+	*/
+	constexpr size_t statsHistogramSize = 256;
+
+	// Layout must match the stats SSBO in clustersstats.glsl.
+	struct CullingStatsRaw {
+		uint32_t overflowingClusters = 0;	// Lists truncated because lightsIndex was full.
+		uint32_t overBudgetClusters = 0;	// Clusters with more lights than the budget (maxLightsPerTile).
+		uint32_t maxLights = 0;
+		uint32_t totalIndices = 0;
+		uint32_t histogram[statsHistogramSize] = {};
+	};
+
+	struct CullingStats {
+		int64_t frame = 0;
+		uint32_t numClusters = 0;
+		uint32_t emptyClusters = 0;
+		uint32_t overflowingClusters = 0;
+		uint32_t overBudgetClusters = 0;
+		uint32_t maxLights = 0;
+		float meanLights = 0.0f;
+		uint32_t p99Lights = 0;
+		uint32_t totalIndices = 0;
+		int64_t falsePositives = -1;		// -1 if not measured.
+		float rebinnedFraction = -1.0f;		// Lights re-binned by binLightsIncremental(), -1 if not used.
+		float visibleFraction = -1.0f;		// Lights kept by preCullLights(), -1 if not used.
+		float cullMs = -1.0f;				// Time to build the CPU lists, -1 for GPU lists.
+		float waitMs = -1.0f;				// Of which the render thread waited (all of it unless culled asynchronously).
+		float lodFraction = -1.0f;			// Lights left by buildLightLOD() (exact + aggregates), -1 if not used.
+	};
+
+	/*
+	* Accumulates the lists written by the CPU cullers: (offset, count) + index lists,
+	* or bitsets (see cullClustersBitset()).
+	*/
+	void gatherListStats(
+		const std::vector<int32_t>& tileLightMapping,
+		const std::vector<int32_t>& lightsIndex,
+		size_t numClusters,
+		size_t numLights,
+		bool bitset,
+		uint32_t budget,
+		CullingStatsRaw& raw
+	);
+
+	CullingStats summarizeCullingStats(const CullingStatsRaw& raw, int64_t frame);
+
+	/*
+	* Brute-force reference for culling precision. For every (cluster, light) entry
+	* of the index lists, casts a ray through each pixel center of the cluster's tile
+	* and checks whether it passes through the light's sphere inside the cluster's
+	* depth slice. Returns the number of entries no pixel confirms (false positives).
+	* Tiled lists are measured with numTiles.z = 1, i.e. a single [zNear, zFar] slice.
+	* Spot lights sample 16 points of the ray inside the sphere against the cone.
+	* Costs up to a ray test per pixel per entry, so it is only for measurements.
+	*/
+	size_t countFalsePositives(
+		Utils::ThreadPool& pool,
+		const std::vector<int32_t>& tileLightMapping,
+		const std::vector<int32_t>& lightsIndex,
+		glm::ivec3 numTiles,
+		glm::ivec2 viewportSize,
+		const std::vector<LightVolume>& lights,
+		const glm::mat4& projMatrix,
+		const DepthSlicing& slicing
+	);
+
+}
\ No newline at end of file
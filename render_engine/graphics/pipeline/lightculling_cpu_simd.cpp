@@ -0,0 +1,213 @@
+#include "graphics/pipeline/lightculling_cpu.h"
+
+#include <array>
+#include <cstdint>
+
+/*
+* Vectorized light-rectangle vs. tile kernels for the tiled CPU culler.
+* The AVX2/SSE4 kernels are compiled regardless of the project's /arch setting and
+* selected at runtime from CPUID, so the same binary runs on any x64 machine.
+* AVX2 has no compress-store, so survivors are left-packed with a permutation
+* looked up from the comparison mask and stored as a whole register.
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LIGHTCULLING_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+// MSVC allows any intrinsic in any function.
+#define LIGHTCULLING_TARGET_AVX2
+#define LIGHTCULLING_TARGET_SSE4
+#else
+#include <immintrin.h>
+#define LIGHTCULLING_TARGET_AVX2 __attribute__((target("avx2")))
+#define LIGHTCULLING_TARGET_SSE4 __attribute__((target("sse4.1")))
+#endif
+#endif
+
+
+namespace LightCullingCPU {
+
+	static size_t cullLightRectsScalar(const LightRectsSoA& rects, glm::vec4 tile, int32_t* out) {
+		size_t n = 0;
+		for (size_t i = 0; i < rects.count; i++) {
+			if (rects.minX[i] < tile.z && rects.maxX[i] > tile.x &&
+				rects.minY[i] < tile.w && rects.maxY[i] > tile.y) {
+				out[n++] = (int32_t)i;
+			}
+		}
+		return n;
+	}
+
+
+#ifdef LIGHTCULLING_X86
+
+	// For every 8-bit mask: the lane indices of the set bits, packed to the front.
+	struct LeftPackLUT8 {
+		alignas(32) std::array<std::array<int32_t, 8>, 256> perm;
+		std::array<uint8_t, 256> popcount;
+		LeftPackLUT8() {
+			for (int m = 0; m < 256; m++) {
+				int n = 0;
+				for (int lane = 0; lane < 8; lane++) {
+					if (m & (1 << lane)) {
+						this->perm[m][n++] = lane;
+					}
+				}
+				this->popcount[m] = (uint8_t)n;
+				for (; n < 8; n++) {
+					this->perm[m][n] = 0;
+				}
+			}
+		}
+	};
+	static const LeftPackLUT8 leftPack8;
+
+	// For every 4-bit mask: a pshufb control moving the selected 32-bit lanes to the front.
+	struct LeftPackLUT4 {
+		alignas(16) std::array<std::array<uint8_t, 16>, 16> shuffle;
+		std::array<uint8_t, 16> popcount;
+		LeftPackLUT4() {
+			for (int m = 0; m < 16; m++) {
+				int n = 0;
+				for (int lane = 0; lane < 4; lane++) {
+					if (m & (1 << lane)) {
+						for (int b = 0; b < 4; b++) {
+							this->shuffle[m][4 * n + b] = (uint8_t)(4 * lane + b);
+						}
+						n++;
+					}
+				}
+				this->popcount[m] = (uint8_t)n;
+				for (int b = 4 * n; b < 16; b++) {
+					this->shuffle[m][b] = 0x80;		// Zero the unused bytes.
+				}
+			}
+		}
+	};
+	static const LeftPackLUT4 leftPack4;
+
+
+	LIGHTCULLING_TARGET_AVX2
+	static size_t cullLightRectsAVX2(const LightRectsSoA& rects, glm::vec4 tile, int32_t* out) {
+		const __m256 left = _mm256_set1_ps(tile.x);
+		const __m256 bottom = _mm256_set1_ps(tile.y);
+		const __m256 right = _mm256_set1_ps(tile.z);
+		const __m256 top = _mm256_set1_ps(tile.w);
+		const __m256i laneIdx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		size_t n = 0;
+		for (size_t i = 0; i < rects.paddedCount; i += 8) {
+			__m256 hit = _mm256_and_ps(
+				_mm256_and_ps(
+					_mm256_cmp_ps(_mm256_loadu_ps(&rects.minX[i]), right, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_loadu_ps(&rects.maxX[i]), left, _CMP_GT_OQ)),
+				_mm256_and_ps(
+					_mm256_cmp_ps(_mm256_loadu_ps(&rects.minY[i]), top, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_loadu_ps(&rects.maxY[i]), bottom, _CMP_GT_OQ)));
+			int mask = _mm256_movemask_ps(hit);
+			if (mask == 0) {
+				continue;
+			}
+			__m256i idx = _mm256_add_epi32(_mm256_set1_epi32((int)i), laneIdx);
+			__m256i perm = _mm256_load_si256((const __m256i*)leftPack8.perm[mask].data());
+			_mm256_storeu_si256((__m256i*)(out + n), _mm256_permutevar8x32_epi32(idx, perm));
+			n += leftPack8.popcount[mask];
+		}
+		return n;
+	}
+
+
+	LIGHTCULLING_TARGET_SSE4
+	static size_t cullLightRectsSSE4(const LightRectsSoA& rects, glm::vec4 tile, int32_t* out) {
+		const __m128 left = _mm_set1_ps(tile.x);
+		const __m128 bottom = _mm_set1_ps(tile.y);
+		const __m128 right = _mm_set1_ps(tile.z);
+		const __m128 top = _mm_set1_ps(tile.w);
+		const __m128i laneIdx = _mm_setr_epi32(0, 1, 2, 3);
+		size_t n = 0;
+		for (size_t i = 0; i < rects.paddedCount; i += 4) {
+			__m128 hit = _mm_and_ps(
+				_mm_and_ps(
+					_mm_cmplt_ps(_mm_loadu_ps(&rects.minX[i]), right),
+					_mm_cmpgt_ps(_mm_loadu_ps(&rects.maxX[i]), left)),
+				_mm_and_ps(
+					_mm_cmplt_ps(_mm_loadu_ps(&rects.minY[i]), top),
+					_mm_cmpgt_ps(_mm_loadu_ps(&rects.maxY[i]), bottom)));
+			int mask = _mm_movemask_ps(hit);
+			if (mask == 0) {
+				continue;
+			}
+			__m128i idx = _mm_add_epi32(_mm_set1_epi32((int)i), laneIdx);
+			__m128i shuf = _mm_load_si128((const __m128i*)leftPack4.shuffle[mask].data());
+			_mm_storeu_si128((__m128i*)(out + n), _mm_shuffle_epi8(idx, shuf));
+			n += leftPack4.popcount[mask];
+		}
+		return n;
+	}
+
+
+	static SIMDLevel detectSIMDLevel() {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool avx2 = false;
+		if (maxLeaf >= 7 && osxsave && avx) {
+			// The OS must also save the YMM registers on context switches.
+			bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+			__cpuidex(info, 7, 0);
+			avx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		bool sse41 = __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2)
+			return SIMDLevel::AVX2;
+		if (sse41)
+			return SIMDLevel::SSE4;
+		return SIMDLevel::Scalar;
+	}
+
+#else
+
+	static SIMDLevel detectSIMDLevel() {
+		return SIMDLevel::Scalar;
+	}
+
+#endif
+
+
+	static const SIMDLevel detectedSIMDLevel = detectSIMDLevel();
+	static SIMDLevel activeSIMDLevel = detectedSIMDLevel;
+
+	SIMDLevel getSIMDLevel() {
+		return activeSIMDLevel;
+	}
+
+	void setSIMDLevel(SIMDLevel level) {
+		activeSIMDLevel = (int)level <= (int)detectedSIMDLevel ? level : detectedSIMDLevel;
+	}
+
+
+	size_t cullLightRects(const LightRectsSoA& rects, glm::vec4 tileBounds, int32_t* out) {
+#ifdef LIGHTCULLING_X86
+		switch (activeSIMDLevel) {
+		case SIMDLevel::AVX2:
+			return cullLightRectsAVX2(rects, tileBounds, out);
+		case SIMDLevel::SSE4:
+			return cullLightRectsSSE4(rects, tileBounds, out);
+		default:
+			break;
+		}
+#endif
+		return cullLightRectsScalar(rects, tileBounds, out);
+	}
+
+}
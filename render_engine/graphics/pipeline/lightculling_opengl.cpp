@@ -0,0 +1,1194 @@
+#include "graphics/pipeline/lightculling_opengl.h"
+#include "core/scene.h"
+#include "objects/go_camera.h"
+#include "objects/go_light.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+
+
+LightCulling_OpenGL::~LightCulling_OpenGL() {
+	// The job writes to this object.
+	if (this->pendingCulling.valid())
+		this->pendingCulling.wait();
+	GLuint* buffers[] = {
+		&this->lightsSSBO, &this->globalLightsSSBO, &this->tileLightMappingSSBO, &this->lightsIndexSSBO,
+		&this->globalIndexCountSSBO, &this->depthRangeSSBO, &this->depthRangeReadback, &this->zBinsSSBO,
+		&this->tileMasksSSBO, &this->clustersSSBO, &this->lightBVHSSBO, &this->lightBVHLightsSSBO,
+		&this->indexCountReadback, &this->activeClusterFlagsSSBO, &this->activeClustersSSBO,
+		&this->tileDepthBoundsSSBO, &this->lightRangesSSBO, &this->staticLightsSSBO, &this->staticLightGridSSBO,
+	};
+	for (GLuint* buffer : buffers) {
+		if (*buffer != 0) {
+			glDeleteBuffers(1, buffer);
+			*buffer = 0;
+		}
+	}
+	if (this->depthRangeFence != 0)
+		glDeleteSync(this->depthRangeFence);
+	if (this->indexCountFence != 0)
+		glDeleteSync(this->indexCountFence);
+}
+
+
+void LightCulling_OpenGL::run(Scene* scene, GLuint depthTex, glm::ivec2 viewportSize) {
+	this->depthTex = depthTex;
+	this->viewportSize = viewportSize;
+
+	GO_Camera* camera = scene->getActiveCamera().get();
+	glm::mat4 viewMatrix = camera ? camera->getViewMatrix() : glm::mat4(1.0f);
+	bool async = this->usesAsyncCulling() && camera != nullptr;
+	bool latency = async && this->asyncCullingLatency;
+	bool begun = this->begunFrame;
+	this->begunFrame = false;
+
+	// Lists left in flight by a mode or option that has since changed are stale.
+	if (this->pendingCulling.valid() && !(begun || latency)) {
+		this->pendingCulling.wait();
+		this->pendingCulling = std::future<void>();
+	}
+	// Last frame's lists. Finish them first: splitLights() may remap incrementalState.
+	bool haveLists = false;
+	if (latency && this->pendingCulling.valid()) {
+		this->finishCPUCulling();
+		haveLists = this->culledView.culling == this->culling &&
+			this->culledView.bitsetLists == this->usesBitsetLists();
+	}
+
+	if (camera) {
+		if (!begun) {
+			this->updateDepthSlicing(camera);
+		}
+		this->measureDepthRange(camera);
+	}
+	if (!begun) {
+		this->splitLights(scene);
+		if (this->usesLightLOD() && camera) {
+			this->applyLightLOD(camera);
+		}
+	}
+	if (this->usesLightPreCull() && camera) {
+		this->preCullBoundedLights(camera);
+	}
+	if (this->culling == LightCulling::ZBinned) {
+		this->runZBinnedCPU(scene);
+	}
+	if (latency) {
+		if (!haveLists) {
+			// First frame (or the mode changed): nothing usable culled ahead.
+			this->startCPUCulling(camera, this->boundedLights, this->aggregateLights);
+			this->finishCPUCulling();
+		}
+		// Shade with the lights the lists were built from; cull this frame's for the next.
+		this->nextLights.swap(this->boundedLights);
+		this->nextAggregates.swap(this->aggregateLights);
+		this->boundedLights = this->culledLights;
+		this->aggregateLights = this->culledAggregates;
+		// And with the depth slices they were binned with (see setShadingUniforms()).
+		this->shadedView = this->culledView;
+	}
+	this->shadeCulledView = latency;
+	this->updateLightsSSBO(scene, viewMatrix);
+	if (this->usesCPULightLists() && camera) {
+		if (async) {
+			if (!latency) {
+				if (!begun) {
+					// The pipeline didn't call begin(); cull now.
+					this->startCPUCulling(camera, this->boundedLights, this->aggregateLights);
+				}
+				this->finishCPUCulling();
+			}
+		}
+		else {
+			gatherVolumes(this->clusterLightVolumes, this->boundedLights, this->aggregateLights, viewMatrix);
+			this->culledView = this->makeCPUCullView(camera);
+			this->cullCPU(this->culledView);
+			this->waitMs = this->cullMs;
+		}
+		this->updateTileLightMappingSSBO();
+		this->updateLightsIndexSSBO();
+	}
+	else if (this->culling == LightCulling::TiledGPU) {
+		this->runTilesGPU(scene);
+	}
+	else if (this->culling == LightCulling::ClusteredGPU) {
+		this->runClustersGPU(scene);
+	}
+	if (this->collectCullingStats) {
+		this->gatherCullingStats(scene);
+	}
+	if (latency) {
+		this->startCPUCulling(camera, this->nextLights, this->nextAggregates);
+	}
+}
+
+void LightCulling_OpenGL::begin(Scene* scene) {
+	GO_Camera* camera = scene->getActiveCamera().get();
+	if (!this->usesAsyncCulling() || this->asyncCullingLatency || camera == nullptr) {
+		return;
+	}
+	if (this->pendingCulling.valid()) {
+		// Culled ahead by the latency mode, which has since been turned off.
+		this->pendingCulling.wait();
+	}
+	this->updateDepthSlicing(camera);
+	this->splitLights(scene);
+	if (this->usesLightLOD()) {
+		this->applyLightLOD(camera);
+	}
+	this->startCPUCulling(camera, this->boundedLights, this->aggregateLights);
+	this->begunFrame = true;
+}
+
+void LightCulling_OpenGL::setShadingUniforms(Shader_OpenGL& shader, GO_Camera* camera) {
+	if (this->shadeCulledView) {
+		// The lists were binned a frame earlier, so depthSlice() must use that frame's slices.
+		shader.setUniform1f("zNear", this->shadedView.zNear);
+		shader.setUniform1f("zFar", this->shadedView.zFar);
+		shader.setUniform4f("depthSlicing", this->shadedView.slicing.packed());
+	}
+	else {
+		if (camera) {
+			shader.setUniform1f("zNear", camera->projectionParams.perspective.near);
+			shader.setUniform1f("zFar", camera->projectionParams.perspective.far);
+		}
+		shader.setUniform4f("depthSlicing", this->depthSlicing.packed());
+	}
+	shader.setUniform2i("cullingMethod", glm::ivec2((GLint)this->culling, (GLint)this->usesBitsetLists()));
+	shader.setUniform2f("viewportSize", glm::vec2(this->viewportSize));
+	shader.setUniform3f("numTiles", glm::vec3(this->numTiles));
+	// Dims of 0 turn the static light grid off.
+	shader.setUniform3i("staticGridDims", this->usesStaticLightGrid() ? this->staticGrid.dims : glm::ivec3(0));
+	shader.setUniform3f("staticGridOrigin", this->staticGrid.origin);
+	shader.setUniform1f("staticGridCellSize", this->staticGrid.cellSize);
+	if (camera) {
+		glm::mat4 viewMatrix = camera->getViewMatrix();
+		shader.setUniformMat4("worldToView", viewMatrix);
+		shader.setUniformMat4("viewToWorld", glm::inverse(viewMatrix));
+	}
+}
+
+
+
+
+// Grows the buffer if needed and uploads data to it.
+static void uploadSSBO(GLuint& ssbo, size_t& ssboSize, GLuint binding, const void* data, size_t size) {
+	if (ssbo == 0 || ssboSize < size) {
+		if (ssbo != 0)
+			glDeleteBuffers(1, &ssbo);
+		glGenBuffers(1, &ssbo);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+		// Never allocate an empty buffer; binding one is an error.
+		ssboSize = std::max(size, sizeof(GLint));
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)ssboSize, (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ssbo);
+	}
+	else {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	}
+	if (size > 0) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)size, data);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+// We use all vec4s to avoid common alignment bugs in the OpenGL drivers.
+struct SSBOLight {
+	// Position (xyz) and type (w).
+	// Type matches the enum in go_light.h.
+	// None=0, Dir=1, Point=2, Spot=3.
+	glm::vec4 positionType;			// vec4
+	// Normalized direction for point and spot lights.
+	glm::vec4 direction;			// vec3
+	// Inner & outer angles (radians) for spot lights, then 1 if the falloff is windowed.
+	glm::vec4 innerOuterAngles;		// vec3
+	// Color.
+	glm::vec4 color;				// vec3
+	// Attenuation: (constant, linear, quadratic), then GO_Light::getRange().
+	glm::vec4 attenuation;			// vec4
+};
+
+static void writeSSBOLight(SSBOLight* dst_light, GO_Light* src_light, const glm::mat4& viewMatrix) {
+	glm::vec4 posVector = viewMatrix * src_light->getModelMatrix()[3];
+	glm::vec4 dirVector = viewMatrix * glm::vec4(src_light->getWorldSpaceDirection(), 0.0f);
+	dst_light->positionType = glm::vec4(glm::vec3(posVector), (float)src_light->type);
+	dst_light->direction = glm::vec4(glm::normalize(glm::vec3(dirVector)), 0.0f);
+	dst_light->innerOuterAngles = glm::vec4(src_light->innerOuterAngles, src_light->windowedFalloff ? 1.0f : 0.0f, 0.0f);
+	dst_light->color = glm::vec4(src_light->color, 0.0f);
+	dst_light->attenuation = glm::vec4(src_light->attenuation, src_light->getRange());
+}
+
+// Aggregates are point lights with quadratic attenuation only.
+static void writeSSBOAggregate(SSBOLight* dst_light, const LightCullingCPU::AggregateLight& aggregate, const glm::mat4& viewMatrix) {
+	glm::vec4 posVector = viewMatrix * glm::vec4(aggregate.volume.position, 1.0f);
+	dst_light->positionType = glm::vec4(glm::vec3(posVector), (float)GO_Light::Type::Point);
+	dst_light->direction = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+	dst_light->innerOuterAngles = glm::vec4(0.0f);
+	dst_light->color = glm::vec4(aggregate.emission.color, 0.0f);
+	dst_light->attenuation = glm::vec4(0.0f, 0.0f, aggregate.emission.quadratic, aggregate.volume.radius);
+}
+
+void LightCulling_OpenGL::splitLights(Scene* scene) {
+	this->boundedLights.clear();
+	this->globalLights.clear();
+	this->aggregateLights.clear();
+	this->nextStaticLights.clear();
+	bool useGrid = this->usesStaticLightGrid();
+	for (GO_Light* light : scene->lights) {
+		if (light->type == GO_Light::Type::Point || light->type == GO_Light::Type::Spot) {
+			// Point and spot lights that never fall below their cutoff reach every pixel too.
+			if (!std::isfinite(light->getRange()))
+				this->globalLights.push_back(light);
+			else if (useGrid && light->isStatic)
+				this->nextStaticLights.push_back(light);
+			else
+				this->boundedLights.push_back(light);
+		}
+		else if (light->type == GO_Light::Type::Directional)
+			this->globalLights.push_back(light);
+	}
+	this->updateStaticLightGrid();
+	if (this->sortLights)
+		this->sortBoundedLights();
+}
+
+void LightCulling_OpenGL::updateStaticLightGrid() {
+	const LightCullingCPU::StaticLightGridSettings& settings = this->staticLightGridSettings;
+	bool settingsChanged = settings.cellSize != this->staticGridSettings.cellSize ||
+		settings.maxCells != this->staticGridSettings.maxCells;
+	if (!this->staticLightsDirty && !settingsChanged && this->nextStaticLights == this->staticLights) {
+		return;
+	}
+	this->staticLightsDirty = false;
+	this->staticGridSettings = settings;
+	this->staticLights = this->nextStaticLights;
+
+	LightCullingCPU::gatherLightVolumes(this->staticLightVolumes, this->staticLights, glm::mat4(1.0f));
+	auto start = std::chrono::high_resolution_clock::now();
+	LightCullingCPU::buildStaticLightGrid(this->staticLightVolumes, settings, this->staticGrid);
+	float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	if (this->staticLights.empty()) {
+		return;
+	}
+	std::cout << "Static light grid: " << this->staticLights.size() << " lights, " << this->staticGrid.dims.x << "x" <<
+		this->staticGrid.dims.y << "x" << this->staticGrid.dims.z << " cells of " << this->staticGrid.cellSize << ", " <<
+		this->staticGrid.indices.size() << " entries, built in " << buildMs << " ms\n";
+
+	// World space, so the buffers stay valid as the camera moves.
+	size_t lightsLen = sizeof(glm::ivec4) + this->staticLights.size() * sizeof(SSBOLight);
+	std::vector<uint8_t> lightsBuf(lightsLen);
+	((glm::ivec4*)lightsBuf.data())[0] = glm::ivec4((GLint)this->staticLights.size(), 0, 0, 0);
+	for (size_t i = 0; i < this->staticLights.size(); i++) {
+		SSBOLight* dst_light = ((SSBOLight*)(lightsBuf.data() + sizeof(glm::ivec4))) + i;
+		writeSSBOLight(dst_light, this->staticLights[i], glm::mat4(1.0f));
+	}
+	uploadSSBO(this->staticLightsSSBO, this->staticLightsSSBOSize, staticLightsSSBOBinding, lightsBuf.data(), lightsLen);
+
+	std::vector<GLint> gridBuf;
+	gridBuf.reserve(this->staticGrid.cells.size() + this->staticGrid.indices.size());
+	gridBuf.insert(gridBuf.end(), this->staticGrid.cells.begin(), this->staticGrid.cells.end());
+	gridBuf.insert(gridBuf.end(), this->staticGrid.indices.begin(), this->staticGrid.indices.end());
+	uploadSSBO(this->staticLightGridSSBO, this->staticLightGridSSBOSize, staticLightGridSSBOBinding,
+		gridBuf.data(), sizeof(GLint) * gridBuf.size());
+}
+
+void LightCulling_OpenGL::sortBoundedLights() {
+	if (!this->cullingWorkers) {
+		this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+	}
+	size_t numLights = this->boundedLights.size();
+	this->lightPositions.resize(numLights);
+	for (size_t i = 0; i < numLights; i++) {
+		this->lightPositions[i] = glm::vec3(this->boundedLights[i]->getModelMatrix()[3]);
+	}
+	this->lightOrder.swap(this->previousLightOrder);
+	LightCullingCPU::mortonOrder(*this->cullingWorkers, this->lightPositions, this->lightOrder, this->mortonScratch);
+
+	std::vector<GO_Light*> unsorted = this->boundedLights;
+	for (size_t k = 0; k < numLights; k++) {
+		this->boundedLights[k] = unsorted[this->lightOrder[k]];
+	}
+
+	// State kept between frames is indexed by last frame's order.
+	if (this->lightOrder != this->previousLightOrder) {
+		std::vector<int32_t> newIndexOfOld;
+		if (this->previousLightOrder.size() == numLights) {
+			std::vector<int32_t> sortedIndex(numLights);
+			for (size_t k = 0; k < numLights; k++) {
+				sortedIndex[this->lightOrder[k]] = (int32_t)k;
+			}
+			newIndexOfOld.resize(numLights);
+			for (size_t k = 0; k < numLights; k++) {
+				newIndexOfOld[k] = sortedIndex[this->previousLightOrder[k]];
+			}
+		}
+		LightCullingCPU::remapIncrementalBinning(this->incrementalState, newIndexOfOld);
+	}
+}
+
+void LightCulling_OpenGL::applyLightLOD(GO_Camera* camera) {
+	if (!this->cullingWorkers) {
+		this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+	}
+	size_t numLights = this->boundedLights.size();
+	glm::mat4 viewMatrix = camera->getViewMatrix();
+	LightCullingCPU::gatherLightVolumes(this->clusterLightVolumes, this->boundedLights, viewMatrix);
+	this->lightEmissions.resize(numLights);
+	for (size_t i = 0; i < numLights; i++) {
+		// Only lights the aggregates' quadratic falloff describes may be merged; a
+		// quadratic of 0 keeps the others exact.
+		GO_Light* light = this->boundedLights[i];
+		bool quadraticOnly = light->attenuation.x == 0.0f && light->attenuation.y == 0.0f && !light->windowedFalloff;
+		this->lightEmissions[i].color = light->color;
+		this->lightEmissions[i].quadratic = quadraticOnly ? light->attenuation.z : 0.0f;
+	}
+	LightCullingCPU::buildLightLOD(
+		*this->cullingWorkers,
+		this->clusterLightVolumes,
+		this->lightEmissions,
+		camera->getProjectionMatrix(),
+		this->lightLODSettings,
+		this->lightLODState
+	);
+
+	// exact is increasing, so this compacts in place.
+	const std::vector<int32_t>& exact = this->lightLODState.exact;
+	for (size_t k = 0; k < exact.size(); k++) {
+		this->boundedLights[k] = this->boundedLights[exact[k]];
+	}
+	this->boundedLights.resize(exact.size());
+	// Kept in world space, like the lights, so they can be uploaded with a later view.
+	glm::mat4 inverseView = glm::inverse(viewMatrix);
+	this->aggregateLights = this->lightLODState.aggregates;
+	for (LightCullingCPU::AggregateLight& aggregate : this->aggregateLights) {
+		aggregate.volume.position = glm::vec3(inverseView * glm::vec4(aggregate.volume.position, 1.0f));
+	}
+	size_t numLeft = this->boundedLights.size() + this->aggregateLights.size();
+	this->lodLightFraction = numLights > 0 ? numLeft / (float)numLights : 1.0f;
+}
+
+void LightCulling_OpenGL::gatherVolumes(
+	std::vector<LightCullingCPU::LightVolume>& volumes,
+	const std::vector<GO_Light*>& lights,
+	const std::vector<LightCullingCPU::AggregateLight>& aggregates,
+	const glm::mat4& viewMatrix
+) {
+	LightCullingCPU::gatherLightVolumes(volumes, lights, viewMatrix);
+	for (const LightCullingCPU::AggregateLight& aggregate : aggregates) {
+		LightCullingCPU::LightVolume lv = aggregate.volume;
+		lv.position = glm::vec3(viewMatrix * glm::vec4(lv.position, 1.0f));
+		volumes.push_back(lv);
+	}
+}
+
+void LightCulling_OpenGL::preCullBoundedLights(GO_Camera* camera) {
+	size_t numExact = this->boundedLights.size();
+	size_t numLights = numExact + this->aggregateLights.size();
+	gatherVolumes(this->clusterLightVolumes, this->boundedLights, this->aggregateLights, camera->getViewMatrix());
+	LightCullingCPU::preCullLights(
+		this->clusterLightVolumes,
+		this->numTiles,
+		camera->getProjectionMatrix(),
+		this->depthSlicing,
+		this->visibleLights,
+		this->lightRanges
+	);
+	// Compact in place; visibleLights is increasing, so nothing is overwritten before it's read.
+	// The aggregates come after the exact lights, in both lists.
+	size_t numVisibleExact = 0;
+	size_t numVisibleAggregates = 0;
+	for (int32_t i : this->visibleLights) {
+		if ((size_t)i < numExact) {
+			this->boundedLights[numVisibleExact++] = this->boundedLights[i];
+		}
+		else {
+			this->aggregateLights[numVisibleAggregates++] = this->aggregateLights[i - numExact];
+		}
+	}
+	this->boundedLights.resize(numVisibleExact);
+	this->aggregateLights.resize(numVisibleAggregates);
+	this->visibleLightFraction = numLights > 0 ? this->visibleLights.size() / (float)numLights : 1.0f;
+
+	uploadSSBO(this->lightRangesSSBO, this->lightRangesSSBOSize, lightRangesSSBOBinding,
+		this->lightRanges.data(), sizeof(LightCullingCPU::LightClusterRange) * this->lightRanges.size());
+}
+
+void LightCulling_OpenGL::updateLightsSSBO(Scene* scene, glm::mat4 viewMatrix) {
+	if (!scene) return;
+	std::vector<GO_Light*>& lights = this->boundedLights;
+	// With lightLOD, the aggregates follow the exact lights.
+	size_t numLights = lights.size() + this->aggregateLights.size();
+	// The number of lights changes every frame with preCullLights, so only reallocate to grow.
+	if (this->lightsSSBO == 0 || this->lightsSSBOCapacity < numLights) {
+		if (this->lightsSSBO != 0)
+			glDeleteBuffers(1, &this->lightsSSBO);
+		glGenBuffers(1, &this->lightsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsSSBO);
+		// +4 for ivec4 numLights
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::ivec4) + numLights * sizeof(SSBOLight), (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->lightsSSBOBinding, this->lightsSSBO);
+		this->lightsSSBOCapacity = numLights;
+	}
+	else {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsSSBO);
+	}
+	this->lightsSSBONumLights = numLights;
+
+	size_t len = sizeof(glm::ivec4) + numLights * sizeof(SSBOLight);
+	uint8_t* buf = new uint8_t[len];
+	// First element is number of lights.
+	((glm::ivec4*)buf)[0] = glm::ivec4((GLint)numLights, 0, 0, 0);
+	// Rest of the array is SSBOLight classes.
+	// ZBinned indexes lights in depth-sorted order.
+	const int32_t* order = nullptr;
+	if (this->culling == LightCulling::ZBinned && this->zBins.order.size() == numLights)
+		order = this->zBins.order.data();
+	for (size_t i = 0; i < numLights; i++) {
+		size_t src = order ? (size_t)order[i] : i;
+		SSBOLight* dst_light = ((SSBOLight*)(buf + sizeof(glm::ivec4))) + i;
+		if (src < lights.size())
+			writeSSBOLight(dst_light, lights[src], viewMatrix);
+		else
+			writeSSBOAggregate(dst_light, this->aggregateLights[src - lights.size()], viewMatrix);
+	}
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)len, buf);
+	delete[] buf;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Same layout for the global lights.
+	size_t globalLen = sizeof(glm::ivec4) + this->globalLights.size() * sizeof(SSBOLight);
+	std::vector<uint8_t> globalBuf(globalLen);
+	((glm::ivec4*)globalBuf.data())[0] = glm::ivec4((GLint)this->globalLights.size(), 0, 0, 0);
+	for (size_t i = 0; i < this->globalLights.size(); i++) {
+		SSBOLight* dst_light = ((SSBOLight*)(globalBuf.data() + sizeof(glm::ivec4))) + i;
+		writeSSBOLight(dst_light, this->globalLights[i], viewMatrix);
+	}
+	uploadSSBO(this->globalLightsSSBO, this->globalLightsSSBOSize, globalLightsSSBOBinding, globalBuf.data(), globalLen);
+}
+
+
+
+void LightCulling_OpenGL::updateTileLightMappingSSBO() {
+	size_t numClusters = (size_t)this->numTiles.x * this->numTiles.y * this->numTiles.z;
+	// The values a CPU culler is expected to have written.
+	size_t numValues = numClusters * 2;
+	if (this->usesBitsetLists())
+		numValues = numClusters * LightCullingCPU::bitsetSummaryWords(this->lightsSSBONumLights);
+	size_t neededSize = sizeof(GLint) * std::max(numValues, numClusters * 2);
+	if (this->tileLightMappingSSBO == 0 || this->tileLightMappingRes != this->numTiles ||
+		this->tileLightMappingSSBOSize < neededSize) {
+		if (this->tileLightMappingSSBO != 0)
+			glDeleteBuffers(1, &this->tileLightMappingSSBO);
+		glGenBuffers(1, &this->tileLightMappingSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)neededSize, (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBOBinding, this->tileLightMappingSSBO);
+		this->tileLightMappingRes = this->numTiles;
+		this->tileLightMappingSSBOSize = neededSize;
+		std::cout << "REALLOCATING tileLightMapping\n";
+	}
+	else {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBO);
+	}
+	if (this->usesCPULightLists()) {
+		if (this->tileLightMapping.size() != numValues) {
+			std::cout << "TILE LIGHT MAPPING MISMATCH: " << this->tileLightMapping.size() << " | " <<
+				this->numTiles.x << "," << this->numTiles.y << "," << this->numTiles.z << "\n";
+			return;
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0,
+			(GLsizeiptr)(sizeof(GLint) * this->tileLightMapping.size()), this->tileLightMapping.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightCulling_OpenGL::updateLightsIndexSSBO() {
+	size_t neededSize;
+	if (this->usesCPULightLists())
+		neededSize = sizeof(GLint) * this->lightsIndex.size();
+	else if (this->usesCompactGPULists())
+		neededSize = sizeof(GLint) * this->compactIndexCapacity;
+	else if (this->usesBitsetLists())
+		neededSize = sizeof(GLint) * LightCullingCPU::bitsetWords(this->lightsSSBONumLights) *
+			this->numTiles.x * this->numTiles.y * this->numTiles.z;
+	else
+		neededSize = sizeof(GLint) * this->maxLightsPerTile * this->numTiles.x * this->numTiles.y * this->numTiles.z;
+	if (this->lightsIndexSSBO == 0 || this->lightsIndexSSBOSize < neededSize) {
+		if (this->lightsIndexSSBO != 0)
+			glDeleteBuffers(1, &this->lightsIndexSSBO);
+		glGenBuffers(1, &this->lightsIndexSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)neededSize, (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBOBinding, this->lightsIndexSSBO);
+		this->lightsIndexSSBOSize = neededSize;
+		std::cout << "REALLOCATING lightsIndex (SSBO=" << this->lightsIndexSSBO << ") with size " << neededSize << "\n";
+	}
+	else {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBO);
+	}
+	if (this->usesCPULightLists()) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0,
+			(GLsizeiptr)(sizeof(GLint) * this->lightsIndex.size()), this->lightsIndex.data());
+	}
+	if (this->globalIndexCountSSBO == 0) {
+		glGenBuffers(1, &this->globalIndexCountSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)sizeof(GLuint), (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBOBinding, this->globalIndexCountSSBO);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+
+
+LightCulling_OpenGL::CPUCullView LightCulling_OpenGL::makeCPUCullView(GO_Camera* camera) const {
+	CPUCullView view;
+	view.projMatrix = camera->getProjectionMatrix();
+	view.zNear = camera->projectionParams.perspective.near;
+	view.zFar = camera->projectionParams.perspective.far;
+	// depthSlicing is set by updateDepthSlicing() at the start of the frame.
+	view.slicing = this->depthSlicing;
+	view.culling = this->culling;
+	view.bitsetLists = this->usesBitsetLists();
+	return view;
+}
+
+void LightCulling_OpenGL::cullCPU(const CPUCullView& view) {
+	auto start = std::chrono::steady_clock::now();
+	if (view.culling == LightCulling::TiledCPU) {
+		this->cullTilesCPU(view);
+	}
+	else if (view.culling == LightCulling::ClusteredCPU) {
+		this->cullClustersCPU(view);
+	}
+	else if (view.culling == LightCulling::BinnedCPU) {
+		this->cullBinnedCPU(view);
+	}
+	this->cullMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightCulling_OpenGL::startCPUCulling(GO_Camera* camera, const std::vector<GO_Light*>& lights,
+	const std::vector<LightCullingCPU::AggregateLight>& aggregates) {
+	if (!this->asyncWorker) {
+		// Counts the calling thread, so this is one worker.
+		this->asyncWorker = std::make_unique<Utils::ThreadPool>(2);
+	}
+	if (!this->cullingWorkers && this->culling == LightCulling::ClusteredCPU) {
+		this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+	}
+	// The job only sees copies: the scene and the camera may change before it finishes.
+	gatherVolumes(this->clusterLightVolumes, lights, aggregates, camera->getViewMatrix());
+	if (&lights != &this->culledLights) {
+		this->culledLights = lights;
+	}
+	if (&aggregates != &this->culledAggregates) {
+		this->culledAggregates = aggregates;
+	}
+	this->culledView = this->makeCPUCullView(camera);
+	CPUCullView view = this->culledView;
+	this->pendingCulling = this->asyncWorker->submit([this, view]() {
+		this->cullCPU(view);
+	});
+}
+
+void LightCulling_OpenGL::finishCPUCulling() {
+	auto start = std::chrono::steady_clock::now();
+	this->pendingCulling.get();
+	this->waitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightCulling_OpenGL::cullTilesCPU(const CPUCullView& view) {
+	// Project every light to a screen rectangle once, then test 8 lights per instruction per tile.
+	LightCullingCPU::gatherLightRects(
+		this->lightRects,
+		this->clusterLightVolumes,
+		view.projMatrix,
+		view.zNear,
+		view.zFar
+	);
+	LightCullingCPU::cullTiles(
+		this->lightRects,
+		glm::ivec2(this->numTiles),
+		this->tileLights,
+		this->tileLightMapping,
+		this->lightsIndex
+	);
+}
+
+void LightCulling_OpenGL::updateClustersCPU(const glm::mat4& projMatrix, const LightCullingCPU::DepthSlicing& slicing) {
+	uint64_t key = LightCullingCPU::clusterGridKey(this->numTiles, projMatrix, slicing);
+	if (this->clustersCPU.empty() || this->clustersCPUKey != key) {
+		LightCullingCPU::computeClusterAABBs(
+			this->clustersCPU,
+			this->numTiles,
+			glm::inverse(projMatrix),
+			slicing
+		);
+		this->clustersCPUKey = key;
+	}
+}
+
+void LightCulling_OpenGL::cullClustersCPU(const CPUCullView& view) {
+	if (!this->cullingWorkers) {
+		this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+	}
+	this->updateClustersCPU(view.projMatrix, view.slicing);
+
+	if (view.bitsetLists) {
+		LightCullingCPU::cullClustersBitset(
+			*this->cullingWorkers,
+			this->clustersCPU,
+			this->clusterLightVolumes,
+			this->tileLightMapping,
+			this->lightsIndex
+		);
+	}
+	else if (this->usesLightBVH()) {
+		LightCullingCPU::buildLightBVH(*this->cullingWorkers, this->clusterLightVolumes, this->lightTree);
+		LightCullingCPU::cullClustersBVH(
+			*this->cullingWorkers,
+			this->clustersCPU,
+			this->clusterLightVolumes,
+			this->lightTree,
+			this->tileLightMapping,
+			this->lightsIndex
+		);
+	}
+	else {
+		LightCullingCPU::cullClusters(
+			*this->cullingWorkers,
+			this->clustersCPU,
+			this->clusterLightVolumes,
+			this->tileLightMapping,
+			this->lightsIndex
+		);
+	}
+}
+
+void LightCulling_OpenGL::cullBinnedCPU(const CPUCullView& view) {
+	this->updateClustersCPU(view.projMatrix, view.slicing);
+
+	if (this->incrementalBinning) {
+		LightCullingCPU::binLightsIncremental(
+			this->clustersCPU,
+			this->numTiles,
+			this->clusterLightVolumes,
+			view.projMatrix,
+			view.slicing,
+			this->incrementalMargin,
+			this->incrementalState,
+			this->tileLightMapping,
+			this->lightsIndex
+		);
+	}
+	else {
+		LightCullingCPU::binLights(
+			this->clustersCPU,
+			this->numTiles,
+			this->clusterLightVolumes,
+			view.projMatrix,
+			view.slicing,
+			this->binningScratch,
+			this->tileLightMapping,
+			this->lightsIndex
+		);
+	}
+}
+
+void LightCulling_OpenGL::runZBinnedCPU(Scene* scene) {
+	GO_Camera* camera = scene->getActiveCamera().get();
+	if (camera == nullptr) {
+		return;
+	}
+
+	gatherVolumes(this->clusterLightVolumes, this->boundedLights, this->aggregateLights, camera->getViewMatrix());
+	LightCullingCPU::buildZBins(
+		this->clusterLightVolumes,
+		this->numTiles,
+		camera->getProjectionMatrix(),
+		this->depthSlicing,
+		this->zBins
+	);
+
+	uploadSSBO(this->zBinsSSBO, this->zBinsSSBOSize, this->zBinsSSBOBinding,
+		this->zBins.bins.data(), sizeof(GLint) * this->zBins.bins.size());
+	uploadSSBO(this->tileMasksSSBO, this->tileMasksSSBOSize, this->tileMasksSSBOBinding,
+		this->zBins.tileMasks.data(), sizeof(GLuint) * this->zBins.tileMasks.size());
+}
+
+
+
+
+
+
+void LightCulling_OpenGL::updateClustersSSBO(Scene* scene) {
+	GO_Camera* camera = scene->getActiveCamera().get();
+	if (!camera)
+		return;
+	this->updateClustersCPU(camera->getProjectionMatrix(), this->depthSlicing);
+	GLsizeiptr size = (GLsizeiptr)(sizeof(LightCullingCPU::ClusterAABB) * this->clustersCPU.size());
+	if (this->clustersSSBO == 0 || this->clustersRes != this->numTiles) {
+		if (this->clustersSSBO != 0)
+			glDeleteBuffers(1, &this->clustersSSBO);
+		glGenBuffers(1, &this->clustersSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->clustersSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, size, this->clustersCPU.data(), GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->clustersSSBOBinding, this->clustersSSBO);
+		this->clustersRes = this->numTiles;
+		std::cout << "REALLOCATING clustersSSBO\n";
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->clustersSSBOKey = this->clustersCPUKey;
+	}
+	else if (this->clustersSSBOKey != this->clustersCPUKey) {
+		// Same grid, new projection (FOV, aspect or near/far changed).
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->clustersSSBO);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, size, this->clustersCPU.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->clustersSSBOKey = this->clustersCPUKey;
+	}
+}
+
+
+
+
+
+// Layout must match BVHLight in clustersbvh.glsl.
+struct SSBOBVHLight {
+	glm::vec4 sphere;
+	glm::vec4 coneAxis;				// (axis, cos of the outer angle). w < -1 without a cone.
+	glm::vec4 coneApex;				// (apex, range)
+	glm::ivec4 lightIndex;			// x: index in lightsSSBO.
+};
+
+void LightCulling_OpenGL::uploadLightBVH() {
+	const LightCullingCPU::LightBVH& bvh = this->lightTree;
+	size_t nodesLen = sizeof(glm::ivec4) + bvh.nodes.size() * sizeof(LightCullingCPU::LightBVHNode);
+	std::vector<uint8_t> nodesBuf(nodesLen);
+	((glm::ivec4*)nodesBuf.data())[0] = glm::ivec4((GLint)bvh.nodes.size(), (GLint)bvh.lights.size(),
+		(GLint)bvh.unbounded.size(), 0);
+	std::copy(bvh.nodes.begin(), bvh.nodes.end(), (LightCullingCPU::LightBVHNode*)(nodesBuf.data() + sizeof(glm::ivec4)));
+	uploadSSBO(this->lightBVHSSBO, this->lightBVHSSBOSize, lightBVHSSBOBinding, nodesBuf.data(), nodesLen);
+
+	// Leaf lights first, then the unbounded ones.
+	std::vector<SSBOBVHLight> lights(bvh.lights.size() + bvh.unbounded.size());
+	for (size_t k = 0; k < lights.size(); k++) {
+		int32_t i = k < bvh.lights.size() ? bvh.lights[k] : bvh.unbounded[k - bvh.lights.size()];
+		const LightCullingCPU::LightVolume& lv = this->clusterLightVolumes[i];
+		lights[k].sphere = glm::vec4(lv.position, lv.radius);
+		lights[k].coneAxis = lv.coneRange > 0.0f ? glm::vec4(lv.coneAxis, lv.coneCos) : glm::vec4(0.0f, 0.0f, 0.0f, -2.0f);
+		lights[k].coneApex = glm::vec4(lv.coneApex, lv.coneRange);
+		lights[k].lightIndex = glm::ivec4(i, 0, 0, 0);
+	}
+	uploadSSBO(this->lightBVHLightsSSBO, this->lightBVHLightsSSBOSize, lightBVHLightsSSBOBinding,
+		lights.data(), sizeof(SSBOBVHLight) * lights.size());
+}
+
+void LightCulling_OpenGL::readBackIndexCount() {
+	if (this->indexCountFence == 0) {
+		return;
+	}
+	GLenum status = glClientWaitSync(this->indexCountFence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		return;		// Not there yet; try again next frame.
+	}
+	glDeleteSync(this->indexCountFence);
+	this->indexCountFence = 0;
+
+	GLuint total = 0;
+	glBindBuffer(GL_COPY_READ_BUFFER, this->indexCountReadback);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(GLuint), &total);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	if (total > this->compactIndexCapacity) {
+		// Grow geometrically so a slowly rising total doesn't reallocate every frame.
+		this->compactIndexCapacity = std::max((size_t)total + total / 2, 2 * this->compactIndexCapacity);
+		std::cout << "GROWING compacted lightsIndex to " << this->compactIndexCapacity << " (total " << total << ")\n";
+	}
+}
+
+void LightCulling_OpenGL::runClustersGPU(Scene* scene) {
+	GLuint numClusters = (GLuint)(this->numTiles.x * this->numTiles.y * this->numTiles.z);
+	if (this->usesCompactGPULists()) {
+		this->readBackIndexCount();
+		if (this->compactIndexCapacity == 0) {
+			// First guess; corrected once the first total comes back.
+			this->compactIndexCapacity = 4 * (size_t)numClusters;
+		}
+	}
+
+	// Also runs cluster AABB gen compute shader if needed.
+	this->updateClustersSSBO(scene);
+	// The next two just make sure the buffers are sufficiently large.
+	this->updateLightsIndexSSBO();
+	this->updateTileLightMappingSSBO();
+
+	// The culler packs the lists with an atomic counter, which has to start at 0.
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GO_Camera* camera = scene->getActiveCamera().get();
+	bool activeOnly = this->activeClusters && camera != nullptr;
+	if (activeOnly) {
+		this->markActiveClusters(camera);
+	}
+	// The BVH walk replaces clusterscull3.glsl; both take the same passes.
+	bool useBVH = this->usesLightBVH() && camera != nullptr;
+	Shader_OpenGL& cullShader = useBVH ? this->clusterBVHShader : this->clusterCullLightsShader;
+	if (useBVH) {
+		if (!this->cullingWorkers) {
+			this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+		}
+		gatherVolumes(this->clusterLightVolumes, this->boundedLights, this->aggregateLights, camera->getViewMatrix());
+		LightCullingCPU::buildLightBVH(*this->cullingWorkers, this->clusterLightVolumes, this->lightTree);
+		this->uploadLightBVH();
+		if (this->clusterBVHShader.getID() == 0) {
+			this->clusterBVHShader.readCompute(
+				"shaders/opengl/clustersbvh.glsl"
+			);
+		}
+	}
+	else if (this->clusterCullLightsShader.getID() == 0) {
+		this->clusterCullLightsShader.readCompute(
+			"shaders/opengl/clusterscull3.glsl"
+		);
+	}
+	cullShader.bind();
+	cullShader.setUniform1i("numClusters", (GLint)numClusters);
+	cullShader.setUniform1i("lightsIndexCapacity", (GLint)(this->lightsIndexSSBOSize / sizeof(GLint)));
+	if (!useBVH) {
+		this->clusterCullLightsShader.setUniform1i("listFormat", (GLint)this->usesBitsetLists());
+		this->clusterCullLightsShader.setUniform1i("preCulled", (GLint)(this->usesLightPreCull() && camera != nullptr));
+		if (camera != nullptr) {
+			const glm::mat4& projMatrix = camera->getProjectionMatrix();
+			this->clusterCullLightsShader.setUniform3i("numTiles", this->numTiles);
+			this->clusterCullLightsShader.setUniform2f("projScale", glm::vec2(projMatrix[0][0], projMatrix[1][1]));
+			this->clusterCullLightsShader.setUniform1f("zNear", camera->projectionParams.perspective.near);
+			this->clusterCullLightsShader.setUniform1f("zFar", camera->projectionParams.perspective.far);
+			this->clusterCullLightsShader.setUniform4f("depthSlicing", this->depthSlicing.packed());
+		}
+	}
+	if (this->collectCullingStats) {
+		this->cullingStats.beginGPUFrame();
+	}
+	cullShader.setUniform1i("recordOverflow", (GLint)this->collectCullingStats);
+	cullShader.setUniform1i("activeOnly", (GLint)activeOnly);
+	// One invocation per cluster, clusterCullGroupSize clusters per workgroup.
+	GLuint numGroups = (numClusters + clusterCullGroupSize - 1) / clusterCullGroupSize;
+	auto dispatchCull = [&]() {
+		if (activeOnly) {
+			glDispatchComputeIndirect((GLintptr)0);
+		}
+		else {
+			glDispatchCompute(numGroups, 1, 1);
+		}
+	};
+
+	if (!this->usesCompactGPULists()) {
+		cullShader.setUniform1i("compactPass", 0);
+		dispatchCull();
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		return;
+	}
+
+	// Count, prefix sum over the clusters, fill.
+	cullShader.setUniform1i("compactPass", 1);
+	dispatchCull();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if (this->clusterScanShader.getID() == 0) {
+		this->clusterScanShader.readCompute(
+			"shaders/opengl/clustersscan.glsl"
+		);
+	}
+	this->clusterScanShader.bind();
+	this->clusterScanShader.setUniform1i("numClusters", (GLint)numClusters);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	cullShader.bind();
+	cullShader.setUniform1i("compactPass", 2);
+	dispatchCull();
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// Copy the total out for readBackIndexCount(), unless the last copy is still in flight.
+	if (this->indexCountFence == 0) {
+		if (this->indexCountReadback == 0) {
+			glGenBuffers(1, &this->indexCountReadback);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->indexCountReadback);
+			glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)sizeof(GLuint), (void*)0, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, this->globalIndexCountSSBO);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->indexCountReadback);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)0, (GLintptr)0, (GLsizeiptr)sizeof(GLuint));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		this->indexCountFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+
+void LightCulling_OpenGL::updateDepthSlicing(GO_Camera* camera) {
+	float zNear = camera->projectionParams.perspective.near;
+	float zFar = camera->projectionParams.perspective.far;
+
+	// Pick up the last measurement if it has come back.
+	if (this->depthRangeFence != 0) {
+		GLenum status = glClientWaitSync(this->depthRangeFence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			glDeleteSync(this->depthRangeFence);
+			this->depthRangeFence = 0;
+			float range[2];
+			glBindBuffer(GL_COPY_READ_BUFFER, this->depthRangeReadback);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(range), range);
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			// min > max when nothing was drawn; keep the last range then.
+			if (range[0] <= range[1]) {
+				this->measuredDepthRange = glm::vec2(range[0], range[1]);
+			}
+		}
+	}
+
+	this->depthSlicing = LightCullingCPU::makeDepthSlicing(this->depthSlicingMode, this->numTiles.z,
+		zNear, zFar, this->hybridSplitDepth, this->measuredDepthRange);
+}
+
+void LightCulling_OpenGL::measureDepthRange(GO_Camera* camera) {
+	float zNear = camera->projectionParams.perspective.near;
+	float zFar = camera->projectionParams.perspective.far;
+	bool adaptive = this->depthSlicingMode == LightCullingCPU::DepthSlicingMode::Adaptive;
+	if (!adaptive || this->depthRangeFence != 0) {
+		return;		// One measurement in flight at a time.
+	}
+	if (this->depthRangeSSBO == 0) {
+		glGenBuffers(1, &this->depthRangeSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->depthRangeSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(2 * sizeof(GLuint)), (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, depthRangeSSBOBinding, this->depthRangeSSBO);
+		glGenBuffers(1, &this->depthRangeReadback);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->depthRangeReadback);
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(2 * sizeof(GLuint)), (void*)0, GL_STREAM_READ);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		this->depthRangeShader.readCompute(
+			"shaders/opengl/depthrange.glsl"
+		);
+	}
+	// (+inf, 0) as float bits.
+	GLuint reset[2] = { 0x7f800000u, 0u };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->depthRangeSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(reset), reset);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	this->depthRangeShader.bind();
+	this->depthRangeShader.setUniformTex("depthTex", this->depthTex, depthTexUnit);
+	this->depthRangeShader.setUniform2f("viewportSize", glm::vec2(this->viewportSize));
+	this->depthRangeShader.setUniform1f("zNear", zNear);
+	this->depthRangeShader.setUniform1f("zFar", zFar);
+	glDispatchCompute(((GLuint)this->viewportSize.x + 15) / 16, ((GLuint)this->viewportSize.y + 15) / 16, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, this->depthRangeSSBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->depthRangeReadback);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)0, (GLintptr)0, (GLsizeiptr)(2 * sizeof(GLuint)));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	this->depthRangeFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+void LightCulling_OpenGL::markActiveClusters(GO_Camera* camera) {
+	GLuint numClusters = (GLuint)(this->numTiles.x * this->numTiles.y * this->numTiles.z);
+
+	size_t flagsSize = sizeof(GLuint) * numClusters;
+	if (this->activeClusterFlagsSSBO == 0 || this->activeClusterFlagsSSBOSize < flagsSize) {
+		if (this->activeClusterFlagsSSBO != 0)
+			glDeleteBuffers(1, &this->activeClusterFlagsSSBO);
+		// Zeroed once here; clusterscompact.glsl clears the flags after that.
+		std::vector<GLuint> zeros(numClusters, 0);
+		glGenBuffers(1, &this->activeClusterFlagsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->activeClusterFlagsSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)flagsSize, zeros.data(), GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, activeClusterFlagsSSBOBinding, this->activeClusterFlagsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->activeClusterFlagsSSBOSize = flagsSize;
+	}
+	size_t listSize = sizeof(GLuint) * (4 + (size_t)numClusters);
+	if (this->activeClustersSSBO == 0 || this->activeClustersSSBOSize < listSize) {
+		if (this->activeClustersSSBO != 0)
+			glDeleteBuffers(1, &this->activeClustersSSBO);
+		glGenBuffers(1, &this->activeClustersSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->activeClustersSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)listSize, (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, activeClustersSSBOBinding, this->activeClustersSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->activeClustersSSBOSize = listSize;
+	}
+	// No culling groups and no IDs yet.
+	GLuint header[4] = { 0, 1, 1, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->activeClustersSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(header), header);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (this->clusterMarkShader.getID() == 0) {
+		this->clusterMarkShader.readCompute(
+			"shaders/opengl/clustersactive.glsl"
+		);
+		this->clusterCompactShader.readCompute(
+			"shaders/opengl/clusterscompact.glsl"
+		);
+	}
+
+	// One invocation per pixel, 16x16 per workgroup.
+	this->clusterMarkShader.bind();
+	this->clusterMarkShader.setUniformTex("depthTex", this->depthTex, depthTexUnit);
+	this->clusterMarkShader.setUniform3i("numTiles", this->numTiles);
+	this->clusterMarkShader.setUniform2f("viewportSize", glm::vec2(this->viewportSize));
+	this->clusterMarkShader.setUniform1f("zNear", camera->projectionParams.perspective.near);
+	this->clusterMarkShader.setUniform1f("zFar", camera->projectionParams.perspective.far);
+	this->clusterMarkShader.setUniform4f("depthSlicing", this->depthSlicing.packed());
+	glDispatchCompute(((GLuint)this->viewportSize.x + 15) / 16, ((GLuint)this->viewportSize.y + 15) / 16, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	this->clusterCompactShader.bind();
+	this->clusterCompactShader.setUniform1i("listFormat", (GLint)this->usesBitsetLists());
+	this->clusterCompactShader.setUniform1i("numClusters", (GLint)numClusters);
+	this->clusterCompactShader.setUniform1i("numLights", (GLint)this->lightsSSBONumLights);
+	glDispatchCompute((numClusters + clusterCullGroupSize - 1) / clusterCullGroupSize, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, this->activeClustersSSBO);
+}
+
+
+void LightCulling_OpenGL::runTilesGPU(Scene* scene) {
+	GO_Camera* camera = scene->getActiveCamera().get();
+	if (camera == nullptr) {
+		return;
+	}
+	float zNear = camera->projectionParams.perspective.near;
+	float zFar = camera->projectionParams.perspective.far;
+	glm::ivec2 numTiles2D = glm::ivec2(this->numTiles);
+
+	// The next two just make sure the buffers are sufficiently large.
+	this->updateLightsIndexSSBO();
+	this->updateTileLightMappingSSBO();
+	size_t depthBoundsSize = sizeof(glm::vec2) * numTiles2D.x * numTiles2D.y;
+	if (this->tileDepthBoundsSSBO == 0 || this->tileDepthBoundsSSBOSize < depthBoundsSize) {
+		if (this->tileDepthBoundsSSBO != 0)
+			glDeleteBuffers(1, &this->tileDepthBoundsSSBO);
+		glGenBuffers(1, &this->tileDepthBoundsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileDepthBoundsSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)depthBoundsSize, (void*)0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, tileDepthBoundsSSBOBinding, this->tileDepthBoundsSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		this->tileDepthBoundsSSBOSize = depthBoundsSize;
+	}
+
+	// The culler packs the lists with an atomic counter, which has to start at 0.
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (this->tileDepthShader.getID() == 0) {
+		this->tileDepthShader.readCompute(
+			"shaders/opengl/tilesdepth.glsl"
+		);
+		this->tileCullShader.readCompute(
+			"shaders/opengl/tilescull.glsl"
+		);
+	}
+
+	// Per-tile depth range, one workgroup per tile.
+	this->tileDepthShader.bind();
+	this->tileDepthShader.setUniformTex("depthTex", this->depthTex, depthTexUnit);
+	this->tileDepthShader.setUniform2i("numTiles", numTiles2D);
+	this->tileDepthShader.setUniform2f("viewportSize", glm::vec2(this->viewportSize));
+	this->tileDepthShader.setUniform1f("zNear", zNear);
+	this->tileDepthShader.setUniform1f("zFar", zFar);
+	glDispatchCompute((GLuint)numTiles2D.x, (GLuint)numTiles2D.y, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	const glm::mat4& projMatrix = camera->getProjectionMatrix();
+	this->tileCullShader.bind();
+	this->tileCullShader.setUniform1i("lightsIndexCapacity", (GLint)(this->lightsIndexSSBOSize / sizeof(GLint)));
+	this->tileCullShader.setUniform2i("numTiles", numTiles2D);
+	this->tileCullShader.setUniform2f("projScale", glm::vec2(projMatrix[0][0], projMatrix[1][1]));
+	this->tileCullShader.setUniform1f("zNear", zNear);
+	this->tileCullShader.setUniform1f("zFar", zFar);
+	if (this->collectCullingStats) {
+		this->cullingStats.beginGPUFrame();
+	}
+	this->tileCullShader.setUniform1i("recordOverflow", (GLint)this->collectCullingStats);
+	glDispatchCompute(
+		((GLuint)numTiles2D.x + tileCullGroupSize - 1) / tileCullGroupSize,
+		((GLuint)numTiles2D.y + tileCullGroupSize - 1) / tileCullGroupSize,
+		1
+	);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+
+json LightCulling_OpenGL::takeCullingStats() {
+	return this->cullingStats.take();
+}
+
+void LightCulling_OpenGL::gatherCullingStats(Scene* scene) {
+	this->cullingStats.poll();
+	float lodFraction = this->usesLightLOD() ? this->lodLightFraction : -1.0f;
+	size_t numClusters = (size_t)this->numTiles.x * this->numTiles.y * this->numTiles.z;
+	if (this->usesCPULightLists()) {
+		if (!this->usesBitsetLists()) {
+			// TiledCPU only fills one layer.
+			numClusters = this->tileLightMapping.size() / 2;
+		}
+		LightCullingCPU::CullingStatsRaw raw;
+		LightCullingCPU::gatherListStats(this->tileLightMapping, this->lightsIndex, numClusters,
+			this->lightsSSBONumLights, this->usesBitsetLists(), (uint32_t)this->maxLightsPerTile, raw);
+
+		// Measured against the view and volumes the lists were built from, which are
+		// a frame old with asyncCullingLatency.
+		int64_t falsePositives = -1;
+		if (this->measureFalsePositives && !this->usesBitsetLists()) {
+			if (!this->cullingWorkers) {
+				this->cullingWorkers = std::make_unique<Utils::ThreadPool>();
+			}
+			glm::ivec3 listTiles = this->numTiles;
+			LightCullingCPU::DepthSlicing listSlicing = this->culledView.slicing;
+			if (this->culling == LightCulling::TiledCPU) {
+				listTiles.z = 1;
+				listSlicing = LightCullingCPU::makeDepthSlicing(LightCullingCPU::DepthSlicingMode::Exponential, 1,
+					this->culledView.zNear, this->culledView.zFar, 0.0f, glm::vec2(0.0f));
+			}
+			falsePositives = (int64_t)LightCullingCPU::countFalsePositives(
+				*this->cullingWorkers,
+				this->tileLightMapping,
+				this->lightsIndex,
+				listTiles,
+				this->viewportSize,
+				this->clusterLightVolumes,
+				this->culledView.projMatrix,
+				listSlicing
+			);
+		}
+		float rebinnedFraction = -1.0f;
+		if (this->incrementalBinning && this->culling == LightCulling::BinnedCPU) {
+			size_t numBinned = this->incrementalState.binned.size();
+			rebinnedFraction = numBinned > 0 ? this->incrementalState.lastRebinned / (float)numBinned : 0.0f;
+		}
+		this->cullingStats.addCPU(raw, falsePositives, rebinnedFraction, this->cullMs, this->waitMs, lodFraction);
+	}
+	else if (this->culling == LightCulling::ClusteredGPU) {
+		this->cullingStats.gatherGPU((GLuint)numClusters, this->usesBitsetLists(),
+			this->lightsSSBONumLights, this->maxLightsPerTile,
+			this->usesLightPreCull() ? this->visibleLightFraction : -1.0f, lodFraction);
+	}
+	else if (this->culling == LightCulling::TiledGPU) {
+		this->cullingStats.gatherGPU((GLuint)(this->numTiles.x * this->numTiles.y), false,
+			this->lightsSSBONumLights, this->maxLightsPerTile, -1.0f, lodFraction);
+	}
+}
\ No newline at end of file
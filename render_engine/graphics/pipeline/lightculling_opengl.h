@@ -0,0 +1,437 @@
+#pragma once
+#include "graphics/graphics_opengl.h"
+#include "graphics/pipeline/cullingstats_opengl.h"
+#include "graphics/pipeline/lightculling_cpu.h"
+#include "utils/threadpool.h"
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
+class GO_Camera;
+class GO_Light;
+class Scene;
+
+
+/*
+* Light culling for the OpenGL pipelines. Owns the light buffers, the per-tile/cluster
+* light lists and every culler that builds them, so each LightCulling mode is
+* implemented once and both RP_Forward_OpenGL and RP_Deferred_OpenGL shade from the
+* same SSBOs. There is one instance per Graphics_OpenGL (getLightCulling()), which
+* keeps its buffers when the render pipeline is switched.
+*
+* Each frame, a pipeline calls begin() once the camera is set, renders its depth (Z pre-pass
+* or gBuffer), calls run(), then binds its shading program and calls setShadingUniforms().
+*/
+class LightCulling_OpenGL {
+public:
+
+	LightCulling_OpenGL() = default;
+	LightCulling_OpenGL(const LightCulling_OpenGL&) = delete;
+	LightCulling_OpenGL& operator=(const LightCulling_OpenGL&) = delete;
+	~LightCulling_OpenGL();
+
+	// Indices should align with values in forward.frag and deferred_light.frag.
+	enum class LightCulling : GLint {
+		None = 0,
+		BoundingSphere = 1,
+		RasterSphere = 2,		// Deferred only: shades one light volume at a time, no lists.
+		TiledCPU = 3,
+		ClusteredCPU = 4,
+		TiledGPU = 5,
+		ClusteredGPU = 6,
+		BinnedCPU = 7,
+		ZBinned = 8,
+	};
+	LightCulling culling = LightCulling::None;
+	// (X,Y,Z) For tiled (instead of clustered), third element should be 1.
+	// For ZBinned, Z is the number of depth bins.
+	glm::ivec3 numTiles = glm::ivec3(80, 45, 32);
+	GLint maxLightsPerTile = 64;
+	// How the numTiles.z depth slices (clusters and ZBinned bins) divide [zNear, zFar].
+	// Hybrid switches from linear to exponential slices at hybridSplitDepth. Adaptive fits
+	// the slices to the depth range of the pipeline's depth buffer, measured on the GPU
+	// and read back a few frames later.
+	LightCullingCPU::DepthSlicingMode depthSlicingMode = LightCullingCPU::DepthSlicingMode::Exponential;
+	float hybridSplitDepth = 5.0f;
+
+	// How ClusteredCPU/ClusteredGPU store each cluster's lights. The other modes always use IndexList.
+	// Values are passed to the shaders as cullingMethod.y.
+	enum class LightListFormat : GLint {
+		IndexList = 0,		// (offset, count) per cluster + compact index list.
+		Bitset = 1,			// One bit per light per cluster + a summary bit per 32 lights.
+	};
+	LightListFormat lightListFormat = LightListFormat::IndexList;
+	// ClusteredGPU with index lists only: build the lists with a count pass, a prefix sum
+	// and a fill pass, and size lightsIndex from the measured total instead of
+	// maxLightsPerTile per cluster.
+	bool compactGPULists = false;
+	// ClusteredCPU/ClusteredGPU with index lists: rebuild a BVH over the lights on the
+	// CPU every frame (LightCullingCPU::buildLightBVH()) and have each cluster walk it
+	// instead of testing every light. Pays off at many thousands of lights.
+	bool lightBVH = false;
+	// Upload the point and spot lights in Morton order of their world-space positions
+	// (LightCullingCPU::mortonOrder()) instead of scene order, so the lights in each
+	// cluster's list sit close together in lightsSSBO.
+	bool sortLights = false;
+	// ClusteredGPU: flag the clusters that hold visible pixels from the depth buffer,
+	// and cull lights only for those (indirect dispatch over the compacted cluster IDs).
+	// The other clusters get empty lists.
+	bool activeClusters = false;
+	// ClusteredGPU: frustum-cull the lights' bounding spheres on the CPU and upload only
+	// the visible ones, each with its conservative cluster range (LightCullingCPU::preCullLights()).
+	// clusterscull3.glsl then tests each light only against the clusters in its range
+	// instead of projecting every light itself.
+	bool preCullLights = false;
+	// Record per-frame light-list statistics for the CPU modes, TiledGPU and ClusteredGPU.
+	// Returned by takeCullingStats() and logged by RenderEngine::launch_eval().
+	bool collectCullingStats = false;
+	// With collectCullingStats and CPU index lists, also count the list entries that no
+	// pixel of their tile/cluster actually needs (LightCullingCPU::countFalsePositives). Slow.
+	bool measureFalsePositives = false;
+	// BinnedCPU only: keep each light's clusters from the previous frame until it moves
+	// out of its enlarged sphere (LightCullingCPU::binLightsIncremental()). The margin
+	// is a fraction of the light's radius; larger means fewer re-bins but longer lists.
+	bool incrementalBinning = false;
+	float incrementalMargin = 0.05f;
+	// TiledCPU, ClusteredCPU and BinnedCPU: build the light lists on a worker thread, started
+	// by begin() and joined by run() just before the lists are uploaded, so the culling
+	// overlaps with the pipeline submitting its depth pass.
+	bool asyncCulling = false;
+	// With asyncCulling: run() uploads the lists started by the previous frame's run(), then
+	// starts the next frame's from this frame's camera and lights, so the culling overlaps
+	// with the whole frame. The lists (and the lights uploaded with them) are one frame late.
+	bool asyncCullingLatency = false;
+	// Light LOD: each frame, merge the point lights that are small on screen into aggregate
+	// point lights (LightCullingCPU::buildLightLOD()), uploaded after the exact lights and
+	// culled like them. Not used by RasterSphere, which draws the scene's lights one by one.
+	bool lightLOD = false;
+	LightCullingCPU::LightLODSettings lightLODSettings;
+	// Static light grid: point and spot lights flagged GO_Light::isStatic are binned once into
+	// a world-space grid (LightCullingCPU::buildStaticLightGrid()) that stays on the GPU and
+	// that the shaders look up by world position, after the culling mode's own lights. Only
+	// the other lights are culled every frame. The grid is rebuilt when the set of static
+	// lights or the settings change, or after invalidateStaticLights(). Not used by
+	// RasterSphere, which draws the scene's lights one by one.
+	bool staticLightGrid = false;
+	LightCullingCPU::StaticLightGridSettings staticLightGridSettings;
+
+	// Rebuild the static light grid on the next frame, e.g. after moving or recoloring a static light.
+	void invalidateStaticLights() {
+		this->staticLightsDirty = true;
+	}
+
+	/*
+	* With asyncCulling (and not asyncCullingLatency), starts this frame's CPU culling on the
+	* worker thread. Call once the camera is final, before rendering the depth pass.
+	* Does nothing otherwise.
+	*/
+	void begin(Scene* scene);
+
+	/*
+	* Uploads the scene's lights and builds this frame's light lists with the current
+	* culling mode. depthTex must hold the frame's finished depth buffer; TiledGPU,
+	* active clusters and adaptive slicing read it (on depthTexUnit).
+	*/
+	void run(Scene* scene, GLuint depthTex, glm::ivec2 viewportSize);
+
+	/*
+	* Sets the light-list uniforms shared by forward.frag and deferred_light.frag
+	* (zNear, zFar, depthSlicing, cullingMethod, viewportSize, numTiles) on the bound shader.
+	*/
+	void setShadingUniforms(Shader_OpenGL& shader, GO_Camera* camera);
+
+	// The point and spot lights in lightsSSBO order (only the visible ones with preCullLights,
+	// and only the exact ones with lightLOD), and the directional lights, as of the last run().
+	const std::vector<GO_Light*>& getBoundedLights() const {
+		return this->boundedLights;
+	}
+	// With lightLOD, the aggregate lights that follow getBoundedLights() in lightsSSBO.
+	// Positions are in world space.
+	const std::vector<LightCullingCPU::AggregateLight>& getAggregateLights() const {
+		return this->aggregateLights;
+	}
+	const std::vector<GO_Light*>& getGlobalLights() const {
+		return this->globalLights;
+	}
+	// With staticLightGrid, the lights in the grid (not in getBoundedLights()).
+	const std::vector<GO_Light*>& getStaticLights() const {
+		return this->staticLights;
+	}
+
+	json takeCullingStats();
+
+	// The view-space cluster AABBs (index x + y*X + z*X*Y) for the current grid and
+	// projection, for debugging tools. Empty until a clustered mode has run. With
+	// asyncCullingLatency the worker may be rebuilding them outside of run().
+	const std::vector<LightCullingCPU::ClusterAABB>& getClusterAABBs() const {
+		return this->clustersCPU;
+	}
+
+	bool usesBitsetLists() const {
+		return this->lightListFormat == LightListFormat::Bitset &&
+			(this->culling == LightCulling::ClusteredCPU || this->culling == LightCulling::ClusteredGPU);
+	}
+
+	// For the compute passes that read the depth buffer; clear of the units the shading passes bind.
+	static constexpr GLuint depthTexUnit = 4;
+
+
+private:
+
+	// The depth buffer and viewport of the pipeline calling run().
+	GLuint depthTex = 0;
+	glm::ivec2 viewportSize = glm::ivec2(0);
+
+	GLuint lightsSSBO = 0;
+	size_t lightsSSBONumLights = 0;
+	size_t lightsSSBOCapacity = 0;		// In lights. Grown as needed, never shrunk.
+	static constexpr GLuint lightsSSBOBinding = 0;		// Must align with forward.frag and deferred_light.frag
+	void updateLightsSSBO(Scene* scene, glm::mat4 viewMatrix);
+
+	// Lights that go through culling (point and spot) and lights that reach every pixel
+	// (directional, and point and spot lights with an infinite range). Only boundedLights are in lightsSSBO and indexed by the light lists;
+	// globalLights have their own buffer that the shaders always loop over. With
+	// staticLightGrid, static point and spot lights go to staticLights instead.
+	std::vector<GO_Light*> boundedLights;
+	std::vector<GO_Light*> globalLights;
+	void splitLights(Scene* scene);		// Call before any culling each frame.
+	// With sortLights, boundedLights[k] is the lightOrder[k]-th bounded light in scene order.
+	std::vector<int32_t> lightOrder;
+	std::vector<int32_t> previousLightOrder;
+	std::vector<glm::vec3> lightPositions;		// Scratch.
+	LightCullingCPU::MortonScratch mortonScratch;
+	void sortBoundedLights();				// Called by splitLights().
+	// Light LOD. The aggregates follow boundedLights in lightsSSBO and in every light volume list.
+	bool usesLightLOD() const {
+		return this->lightLOD && this->culling != LightCulling::RasterSphere;
+	}
+	std::vector<LightCullingCPU::AggregateLight> aggregateLights;
+	LightCullingCPU::LightLOD lightLODState;
+	std::vector<LightCullingCPU::LightEmission> lightEmissions;	// Scratch.
+	float lodLightFraction = 1.0f;			// Lights left by the last LOD pass, for the stats.
+	// Replaces the merged lights in boundedLights with aggregateLights. Call after splitLights().
+	void applyLightLOD(GO_Camera* camera);
+	// gatherLightVolumes() followed by the aggregates' volumes.
+	static void gatherVolumes(
+		std::vector<LightCullingCPU::LightVolume>& volumes,
+		const std::vector<GO_Light*>& lights,
+		const std::vector<LightCullingCPU::AggregateLight>& aggregates,
+		const glm::mat4& viewMatrix
+	);
+	GLuint globalLightsSSBO = 0;
+	size_t globalLightsSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint globalLightsSSBOBinding = 8;	// Must align with forward.frag and deferred_light.frag
+
+	// Static light grid. staticLightsSSBO holds the static lights in world space, in the
+	// lightsSSBO layout; staticLightGridSSBO holds staticGrid.cells followed by staticGrid.indices.
+	// Both are only uploaded when the grid is rebuilt.
+	bool usesStaticLightGrid() const {
+		return this->staticLightGrid && this->culling != LightCulling::RasterSphere;
+	}
+	std::vector<GO_Light*> staticLights;		// In the grid, in staticLightsSSBO order.
+	std::vector<GO_Light*> nextStaticLights;	// Filled by splitLights().
+	bool staticLightsDirty = true;
+	LightCullingCPU::StaticLightGridSettings staticGridSettings;		// The grid was built with.
+	LightCullingCPU::StaticLightGrid staticGrid;
+	std::vector<LightCullingCPU::LightVolume> staticLightVolumes;	// Scratch.
+	GLuint staticLightsSSBO = 0;
+	size_t staticLightsSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint staticLightsSSBOBinding = 16;		// Must align with forward.frag and deferred_light.frag
+	GLuint staticLightGridSSBO = 0;
+	size_t staticLightGridSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint staticLightGridSSBOBinding = 17;	// Must align with forward.frag and deferred_light.frag
+	// Rebuilds and uploads the grid if nextStaticLights or the settings changed. Called by splitLights().
+	void updateStaticLightGrid();
+
+	// Pre-culling. The ranges are uploaded in lightsSSBO order.
+	bool usesLightPreCull() const {
+		return this->preCullLights && this->culling == LightCulling::ClusteredGPU;
+	}
+	std::vector<int32_t> visibleLights;		// Scratch.
+	std::vector<LightCullingCPU::LightClusterRange> lightRanges;
+	float visibleLightFraction = 1.0f;		// Of the last pre-cull, for the stats.
+	GLuint lightRangesSSBO = 0;
+	size_t lightRangesSSBOSize = 0;			// Size in bytes.
+	static constexpr GLuint lightRangesSSBOBinding = 15;	// Must align with clusterscull3.glsl
+	// Drops the lights outside the view frustum from boundedLights. Called by run() after splitLights().
+	void preCullBoundedLights(GO_Camera* camera);
+
+
+	// The SSBO storing mappings to ranges in lightsIndexSSBO (2 values per cluster, pos and len)
+	// With bitset lists, stores each cluster's summary mask instead.
+	GLuint tileLightMappingSSBO = 0;
+	glm::ivec3 tileLightMappingRes;			// The resolution allocated. For tiles, z=1.
+	size_t tileLightMappingSSBOSize = 0;	// Size in bytes.
+	std::vector<GLint> tileLightMapping;	// When using CPU, stores values to be copied into SSBO.
+	static constexpr GLuint tileLightMappingSSBOBinding = 1;		// Must align with deferred_light.frag
+	void updateTileLightMappingSSBO();		// Checks size and, if CPU, copies values from tileLightMapping.
+
+
+	// The SSBO containing light lists for each cluster. tileLightMapping stores ranges in this list.
+	// With bitset lists, stores each cluster's light bits instead.
+	GLuint lightsIndexSSBO = 0;
+	size_t lightsIndexSSBOSize = 0;			// Size in bytes.
+	static constexpr GLuint lightsIndexSSBOBinding = 2;				// Must align with deferred_light.frag
+	std::vector<GLint> lightsIndex;			// When using CPU, stores values to be copied into SSBO.
+	GLuint globalIndexCountSSBO = 0;
+	static constexpr GLuint globalIndexCountSSBOBinding = 4;
+	void updateLightsIndexSSBO();			// Checks size and, if CPU, copies values from lightsIndex.
+
+
+	// What the CPU cullers need from the frame, copied so they can run on another thread.
+	struct CPUCullView {
+		glm::mat4 projMatrix = glm::mat4(1.0f);
+		float zNear = 0.1f;
+		float zFar = 100.0f;
+		LightCullingCPU::DepthSlicing slicing;
+		LightCulling culling = LightCulling::None;		// Lists built with another mode or format are discarded.
+		bool bitsetLists = false;
+	};
+	CPUCullView makeCPUCullView(GO_Camera* camera) const;
+	// Build tileLightMapping and lightsIndex from clusterLightVolumes. No GL calls.
+	void cullTilesCPU(const CPUCullView& view);
+	void cullClustersCPU(const CPUCullView& view);
+	void cullBinnedCPU(const CPUCullView& view);
+	void cullCPU(const CPUCullView& view);		// Dispatches on culling and records cullMs.
+	// True for the modes whose light lists are built on the CPU and uploaded.
+	bool usesCPULightLists() const {
+		return this->culling == LightCulling::TiledCPU ||
+			this->culling == LightCulling::ClusteredCPU ||
+			this->culling == LightCulling::BinnedCPU;
+	}
+	bool usesCompactGPULists() const {
+		return this->compactGPULists && this->culling == LightCulling::ClusteredGPU &&
+			this->lightListFormat == LightListFormat::IndexList;
+	}
+	bool usesLightBVH() const {
+		return this->lightBVH && this->lightListFormat == LightListFormat::IndexList &&
+			(this->culling == LightCulling::ClusteredCPU || this->culling == LightCulling::ClusteredGPU);
+	}
+	bool usesAsyncCulling() const {
+		return this->asyncCulling && this->usesCPULightLists();
+	}
+
+	// Asynchronous CPU culling. Between startCPUCulling() and finishCPUCulling() the job owns
+	// clusterLightVolumes, clustersCPU, tileLightMapping, lightsIndex and the culler scratch
+	// below; the calling thread must not touch them.
+	std::unique_ptr<Utils::ThreadPool> asyncWorker;		// One worker, so jobs run in order.
+	std::future<void> pendingCulling;
+	bool begunFrame = false;				// begin() started the job run() is about to finish.
+	std::vector<GO_Light*> culledLights;	// The lights the pending (or last) lists index, in list order.
+	std::vector<LightCullingCPU::AggregateLight> culledAggregates;		// Indexed after culledLights.
+	std::vector<GO_Light*> nextLights;		// Scratch.
+	std::vector<LightCullingCPU::AggregateLight> nextAggregates;		// Scratch.
+	CPUCullView culledView;					// The view the pending (or last) lists are for.
+	// With asyncCullingLatency, the view of the lists being shaded this frame (culledView
+	// already belongs to the next frame's job by then). shadeCulledView is false otherwise.
+	CPUCullView shadedView;
+	bool shadeCulledView = false;
+	float cullMs = 0.0f;					// Of the last lists, on whichever thread built them.
+	float waitMs = 0.0f;					// How long run() blocked on them.
+	// Gathers the light volumes on the calling thread and culls them on asyncWorker.
+	void startCPUCulling(GO_Camera* camera, const std::vector<GO_Light*>& lights,
+		const std::vector<LightCullingCPU::AggregateLight>& aggregates);
+	void finishCPUCulling();
+
+	// TiledCPU state, cached to avoid reallocating memory.
+	LightCullingCPU::LightRectsSoA lightRects;
+	std::vector<GLint> tileLights;
+
+	// This frame's depth slices, from depthSlicingMode. Passed to the shaders as depthSlicing.
+	LightCullingCPU::DepthSlicing depthSlicing;
+	// Adaptive slicing: depthrange.glsl reduces the depth buffer to its (min, max) view depth,
+	// which is copied out and read back once its fence has signaled, like the index count.
+	Shader_OpenGL depthRangeShader;
+	GLuint depthRangeSSBO = 0;
+	static constexpr GLuint depthRangeSSBOBinding = 14;	// Must align with depthrange.glsl
+	GLuint depthRangeReadback = 0;
+	GLsync depthRangeFence = 0;
+	glm::vec2 measuredDepthRange = glm::vec2(0.0f);		// (0, 0) until the first measurement.
+	void updateDepthSlicing(GO_Camera* camera);			// Picks up the last measurement, if any.
+	void measureDepthRange(GO_Camera* camera);			// Call once the depth buffer is complete.
+
+	// Clustered state. The AABBs are built on the CPU for every clustered mode (ClusteredGPU
+	// uploads them to clustersSSBO) and rebuilt when LightCullingCPU::clusterGridKey() changes.
+	std::vector<LightCullingCPU::ClusterAABB> clustersCPU;
+	uint64_t clustersCPUKey = 0;
+	void updateClustersCPU(const glm::mat4& projMatrix, const LightCullingCPU::DepthSlicing& slicing);
+	std::vector<LightCullingCPU::LightVolume> clusterLightVolumes;
+	LightCullingCPU::BinningScratch binningScratch;
+	LightCullingCPU::IncrementalBinning incrementalState;
+	LightCullingCPU::LightBVH lightTree;
+	// Created on first use so the GPU-only modes don't spin up threads.
+	std::unique_ptr<Utils::ThreadPool> cullingWorkers;
+
+	// ZBinned state. Bins hold (first, last) depth-sorted light per slice; masks hold one bit per light per tile.
+	LightCullingCPU::ZBins zBins;
+	GLuint zBinsSSBO = 0;
+	size_t zBinsSSBOSize = 0;				// Size in bytes.
+	static constexpr GLuint zBinsSSBOBinding = 5;			// Must align with forward.frag and deferred_light.frag
+	GLuint tileMasksSSBO = 0;
+	size_t tileMasksSSBOSize = 0;			// Size in bytes.
+	static constexpr GLuint tileMasksSSBOBinding = 6;		// Must align with forward.frag and deferred_light.frag
+	// Must run before updateLightsSSBO(), which uploads the lights in zBins.order.
+	void runZBinnedCPU(Scene* scene);
+
+
+	GLuint clustersSSBO = 0;
+	glm::ivec3 clustersRes;			// The resolution allocated. For tiles, z=1.
+	uint64_t clustersSSBOKey = 0;	// The clusterGridKey() of the AABBs uploaded.
+	static constexpr GLuint clustersSSBOBinding = 3;		// Must align with deferred_light.frag
+	void updateClustersSSBO(Scene* scene);
+
+
+	Shader_OpenGL clusterCullLightsShader;
+	static constexpr GLuint clusterCullGroupSize = 64;		// Must match GROUP_SIZE in clusterscull3.glsl, clustersbvh.glsl and clusterscompact.glsl
+
+	// Light BVH for ClusteredGPU: the nodes, and the volumes of the lights in leaf order.
+	Shader_OpenGL clusterBVHShader;
+	GLuint lightBVHSSBO = 0;
+	size_t lightBVHSSBOSize = 0;			// Size in bytes.
+	static constexpr GLuint lightBVHSSBOBinding = 9;			// Must align with clustersbvh.glsl
+	GLuint lightBVHLightsSSBO = 0;
+	size_t lightBVHLightsSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint lightBVHLightsSSBOBinding = 10;	// Must align with clustersbvh.glsl
+	void uploadLightBVH();					// Uploads lightTree, built from clusterLightVolumes.
+
+	// Compacted ClusteredGPU lists. The total is copied out after the prefix sum and read
+	// back on a later frame (once its fence has signaled), so the CPU never waits on the GPU.
+	// Until then the lists may be truncated to the current capacity.
+	Shader_OpenGL clusterScanShader;
+	size_t compactIndexCapacity = 0;		// In ints. Grown geometrically, never shrunk.
+	GLuint indexCountReadback = 0;
+	GLsync indexCountFence = 0;
+	void readBackIndexCount();
+
+	// Active clusters. The flags are cleared by clusterscompact.glsl once read; the ID list
+	// starts with the (x, y, z) indirect dispatch size and the number of IDs.
+	Shader_OpenGL clusterMarkShader;
+	Shader_OpenGL clusterCompactShader;
+	GLuint activeClusterFlagsSSBO = 0;
+	size_t activeClusterFlagsSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint activeClusterFlagsSSBOBinding = 12;	// Must align with clustersactive.glsl and clusterscompact.glsl
+	GLuint activeClustersSSBO = 0;
+	size_t activeClustersSSBOSize = 0;			// Size in bytes.
+	static constexpr GLuint activeClustersSSBOBinding = 13;		// Must align with clusterscompact.glsl and clusterscull3.glsl
+	// Leaves activeClustersSSBO bound as the GL_DISPATCH_INDIRECT_BUFFER.
+	void markActiveClusters(GO_Camera* camera);
+
+	void runClustersGPU(Scene* scene);
+
+	// TiledGPU: tilesdepth.glsl reduces the depth buffer to each tile's depth range,
+	// then tilescull.glsl culls the lights against those ranges.
+	Shader_OpenGL tileDepthShader;
+	Shader_OpenGL tileCullShader;
+	static constexpr GLuint tileCullGroupSize = 8;		// Must match GROUP_SIZE_X/Y in tilescull.glsl
+	GLuint tileDepthBoundsSSBO = 0;
+	size_t tileDepthBoundsSSBOSize = 0;		// Size in bytes.
+	static constexpr GLuint tileDepthBoundsSSBOBinding = 11;	// Must align with tilesdepth.glsl and tilescull.glsl
+	void runTilesGPU(Scene* scene);		// Call once the depth buffer is complete.
+
+	CullingStats_OpenGL cullingStats;
+	void gatherCullingStats(Scene* scene);		// Call after the frame's light lists are built.
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "graphics/pipeline/lightculling_cpu.h"
+#include "objects/go_light.h"
+
+#include <cmath>
+#include <limits>
+
+/*
+* The entry points of LightCullingCPU that read scene objects. They are built with the
+* engine rather than the lightculling library, which only sees plain light volumes.
+*/
+
+namespace LightCullingCPU {
+
+	void gatherLightVolumes(
+		std::vector<LightVolume>& volumes,
+		const std::vector<GO_Light*>& lights,
+		const glm::mat4& viewMatrix
+	) {
+		volumes.resize(lights.size());
+		for (size_t i = 0; i < lights.size(); i++) {
+			GO_Light* light = lights[i];
+			volumes[i] = LightVolume();
+			if (light->type == GO_Light::Type::Point || light->type == GO_Light::Type::Spot) {
+				Sphere bs = light->getBoundingSphere();
+				volumes[i].position = glm::vec3(viewMatrix * glm::vec4(bs.position, 1.0f));
+				volumes[i].radius = bs.radius;
+			}
+			else {
+				volumes[i].position = glm::vec3(0.0f);
+				volumes[i].radius = std::numeric_limits<float>::infinity();
+			}
+			float angle = light->innerOuterAngles.y;
+			if (light->type == GO_Light::Type::Spot && angle < glm::radians(90.0f)) {
+				volumes[i].coneApex = glm::vec3(viewMatrix * light->getModelMatrix()[3]);
+				volumes[i].coneAxis = glm::normalize(glm::vec3(viewMatrix * glm::vec4(light->getWorldSpaceDirection(), 0.0f)));
+				volumes[i].coneRange = light->getRange();
+				volumes[i].coneSin = std::sin(angle);
+				volumes[i].coneCos = std::cos(angle);
+			}
+		}
+	}
+
+}
\ No newline at end of file
@@ -8,3 +8,7 @@ void RenderPipeline::init() {}
 void RenderPipeline::resizeFramebuffer(size_t width, size_t height) {}
 
 void RenderPipeline::renderPrimitive(Rectangle rect, Ref<Material> material) {}
+
+json RenderPipeline::takeCullingStats() {
+	return json::array();
+}
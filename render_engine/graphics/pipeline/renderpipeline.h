@@ -4,6 +4,9 @@
 
 #include <string>
 
+#include "nlohmann/json.hpp"
+using json = nlohmann::json;
+
 class Graphics;
 class Scene;
 
@@ -54,6 +57,12 @@ public:
 	virtual void renderMesh(Mesh* mesh) = 0;
 	virtual void renderPrimitive(Rectangle rect, Ref<Material> material);
 
+	/*
+	* Returns the light culling statistics recorded since the last call, one object
+	* per frame, and clears them. Pipelines that don't record any return an empty array.
+	*/
+	virtual json takeCullingStats();
+
 protected:
 
 	Graphics* thisGraphics;
@@ -7,11 +7,13 @@
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 
 
-RP_Forward_OpenGL::RP_Forward_OpenGL(Graphics& graphics) : RP_Forward(graphics) {}
+RP_Forward_OpenGL::RP_Forward_OpenGL(Graphics& graphics) : RP_Forward(graphics),
+	lightCulling(((Graphics_OpenGL&)graphics).getLightCulling()) {}
 
 
 void RP_Forward_OpenGL::init() {
@@ -54,6 +56,9 @@ void RP_Forward_OpenGL::resizeFramebuffer(size_t width, size_t height) {
 	if (glIsTexture(this->postTex)) {
 		glDeleteTextures(1, &this->postTex);
 	}
+	if (glIsTexture(this->postDepthTex)) {
+		glDeleteTextures(1, &this->postDepthTex);
+	}
 	glGenFramebuffers(1, &this->postFBO);
 	glBindFramebuffer(GL_FRAMEBUFFER, this->postFBO);
 	glGenTextures(1, &this->postTex);
@@ -63,10 +68,13 @@ void RP_Forward_OpenGL::resizeFramebuffer(size_t width, size_t height) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->postTex, 0);
 
-	glGenRenderbuffers(1, &this->postDepthRB);
-	glBindRenderbuffer(GL_RENDERBUFFER, this->postDepthRB);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, this->width, this->height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->postDepthRB);
+	// A texture rather than a renderbuffer so TiledGPU can read the Z pre-pass (tilesdepth.glsl).
+	glGenTextures(1, &this->postDepthTex);
+	glBindTexture(GL_TEXTURE_2D, this->postDepthTex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, this->width, this->height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->postDepthTex, 0);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 		std::cout << "Forward renderer: Failed to initialize preGamma buffer.\n";
@@ -179,23 +187,23 @@ void RP_Forward_OpenGL::render(Scene* scene) {
 		viewMatrix = glm::mat4(1.0f);
 		projMatrix = glm::mat4(1.0f);
 	}
+	// With asyncCulling, the CPU culling runs while the pre-pass is submitted.
+	this->lightCulling.begin(scene);
 
 
 	this->zprepassShader.bind();
 	renderSubtree(this->zprepassShader, scene->getRoot().get(), viewMatrix, projMatrix);
 
 
-	this->updateLightsSSBO(scene, viewMatrix);
-	if (this->culling == LightCulling::ClusteredGPU) {
-		this->runClustersGPU(scene);
-	}
+	this->lightCulling.run(scene, this->postDepthTex, glm::ivec2(this->width, this->height));
 
 	this->forwardShader.bind();
-	this->forwardShader.setUniform1f("zNear", scene->getActiveCamera()->projectionParams.perspective.near);
-	this->forwardShader.setUniform1f("zFar", scene->getActiveCamera()->projectionParams.perspective.far);
-	this->forwardShader.setUniform2i("cullingMethod", glm::ivec2((GLint)this->culling, 0));
-	this->forwardShader.setUniform2f("viewportSize", glm::vec2((float)this->width, (float)this->height));
-	this->forwardShader.setUniform3f("numTiles", glm::vec3(this->numTiles));
+	this->lightCulling.setShadingUniforms(this->forwardShader, activeCamera.get());
+	if (this->lightCulling.culling == LightCulling_OpenGL::LightCulling::RasterSphere) {
+		// Light volumes need a gBuffer; shade against every light's bounding sphere instead.
+		this->forwardShader.setUniform2i("cullingMethod",
+			glm::ivec2((GLint)LightCulling_OpenGL::LightCulling::BoundingSphere, 0));
+	}
 
 	glDepthMask(GL_FALSE);
 	renderSubtree(this->forwardShader, scene->getRoot().get(), viewMatrix, projMatrix);
@@ -422,328 +430,6 @@ void RP_Forward_OpenGL::renderPrimitive(
 }
 
 
-
-
-// We use all vec4s to avoid common alignment bugs in the OpenGL drivers.
-struct SSBOLight {
-	// Position (xyz) and type (w).
-	// Type matches the enum in go_light.h.
-	// None=0, Dir=1, Point=2, Spot=3.
-	glm::vec4 positionType;			// vec4
-	// Normalized direction for point and spot lights.
-	glm::vec4 direction;			// vec3
-	// Inner & outer angles (radians) for spot lights.
-	glm::vec4 innerOuterAngles;		// vec2
-	// Color.
-	glm::vec4 color;				// vec3
-	// Attenuation: (constant, linear, quadratic).
-	glm::vec4 attenuation;			// vec3
-};
-
-void RP_Forward_OpenGL::updateLightsSSBO(Scene* scene, glm::mat4 viewMatrix) {
-	if (!scene) return;
-	std::vector<GO_Light*>& lights = scene->lights;
-	if (this->lightsSSBO == 0 || this->lightsSSBONumLights != lights.size()) {
-		if (this->lightsSSBO != 0)
-			glDeleteBuffers(1, &this->lightsSSBO);
-		glGenBuffers(1, &this->lightsSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsSSBO);
-		// +4 for ivec4 numLights
-		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::ivec4) + lights.size() * sizeof(SSBOLight), (void*)0, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->lightsSSBOBinding, this->lightsSSBO);
-		this->lightsSSBONumLights = lights.size();
-	}
-	else {
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsSSBO);
-	}
-
-	size_t len = sizeof(glm::ivec4) + lights.size() * sizeof(SSBOLight);
-	uint8_t* buf = new uint8_t[len];
-	// First element is number of lights.
-	((glm::ivec4*)buf)[0] = glm::ivec4((GLint)lights.size(), 0, 0, 0);
-	// Rest of the array is SSBOLight classes.
-	for (size_t i = 0; i < lights.size(); i++) {
-		GO_Light* src_light = lights[i];
-		SSBOLight* dst_light = ((SSBOLight*)(buf + sizeof(glm::ivec4))) + i;
-		glm::vec4 posVector = viewMatrix * src_light->getModelMatrix()[3];
-		glm::vec4 dirVector = viewMatrix * glm::vec4(src_light->getWorldSpaceDirection(), 0.0f);
-		dst_light->positionType = glm::vec4(glm::vec3(posVector), (float)src_light->type);
-		dst_light->direction = glm::vec4(glm::normalize(glm::vec3(dirVector)), 0.0f);
-		dst_light->innerOuterAngles = glm::vec4(src_light->innerOuterAngles, 0.0f, 0.0f);
-		dst_light->color = glm::vec4(src_light->color, 0.0f);
-		dst_light->attenuation = glm::vec4(src_light->attenuation, 0.0f);
-	}
-	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0, (GLsizeiptr)len, buf);
-	delete[] buf;
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-}
-
-
-
-void RP_Forward_OpenGL::updateTileLightMappingSSBO() {
-	if (this->tileLightMappingSSBO == 0 || this->tileLightMappingRes != this->numTiles) {
-		if (this->tileLightMappingSSBO != 0)
-			glDeleteBuffers(1, &this->tileLightMappingSSBO);
-		glGenBuffers(1, &this->tileLightMappingSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBO);
-		GLsizeiptr size = sizeof(GLint) * this->numTiles.x * this->numTiles.y * this->numTiles.z * 2;
-		glBufferData(GL_SHADER_STORAGE_BUFFER, size, (void*)0, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBOBinding, this->tileLightMappingSSBO);
-		this->tileLightMappingRes = this->numTiles;
-		std::cout << "REALLOCATING tileLightMapping\n";
-	}
-	else {
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBO);
-	}
-	if (this->culling == LightCulling::TiledCPU || this->culling == LightCulling::ClusteredCPU) {
-		if ((GLint)this->tileLightMapping.size() != this->numTiles.x * this->numTiles.y * this->numTiles.z * 2) {
-			std::cout << "TILE LIGHT MAPPING MISMATCH: " << this->tileLightMapping.size() << " | " <<
-				this->numTiles.x << "," << this->numTiles.y << "," << this->numTiles.z << "\n";
-			return;
-		}
-		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0,
-			(GLsizeiptr)(sizeof(GLint) * this->tileLightMapping.size()), this->tileLightMapping.data());
-	}
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-}
-
-void RP_Forward_OpenGL::updateLightsIndexSSBO() {
-	size_t neededSize;
-	if (this->culling == LightCulling::TiledCPU || this->culling == LightCulling::ClusteredCPU)
-		neededSize = sizeof(GLint) * this->lightsIndex.size();
-	else
-		neededSize = sizeof(GLint) * this->maxLightsPerTile * this->numTiles.x * this->numTiles.y * this->numTiles.z;
-	if (this->lightsIndexSSBO == 0 || this->lightsIndexSSBOSize < neededSize) {
-		if (this->lightsIndexSSBO != 0)
-			glDeleteBuffers(1, &this->lightsIndexSSBO);
-		glGenBuffers(1, &this->lightsIndexSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBO);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)neededSize, (void*)0, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBOBinding, this->lightsIndexSSBO);
-		this->lightsIndexSSBOSize = neededSize;
-		std::cout << "REALLOCATING lightsIndex (SSBO=" << this->lightsIndexSSBO << ") with size " << neededSize << "\n";
-	}
-	else {
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBO);
-	}
-	if (this->culling == LightCulling::TiledCPU || this->culling == LightCulling::ClusteredCPU) {
-		glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)0,
-			(GLsizeiptr)(sizeof(GLint) * this->lightsIndex.size()), this->lightsIndex.data());
-	}
-	if (this->globalIndexCountSSBO == 0) {
-		glGenBuffers(1, &this->globalIndexCountSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBO);
-		glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)sizeof(GLuint), (void*)0, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBOBinding, this->globalIndexCountSSBO);
-	}
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-}
-
-
-
-/*
-struct Frustum {
-	glm::vec3 nearPlaneNormal;
-	float nearPlaneDistance;
-	glm::vec3 farPlaneNormal;
-	float farPlaneDistance;
-
-	Frustum(const glm::mat4& projectionMatrix) {
-		glm::vec3 e1, e2, e3;
-		glm::mat4 inverseMatrix = glm::inverse(projectionMatrix);
-
-		e1 = glm::vec3(inverseMatrix[3] + inverseMatrix[0], 0.0f, 0.0f) / inverseMatrix[2];
-		e2 = glm::vec3(0.0f, inverseMatrix[3] + inverseMatrix[5], 0.0f) / inverseMatrix[7];
-		e3 = glm::vec3(inverseMatrix[3] + inverseMatrix[10], inverseMatrix[3] + inverseMatrix[11], 0.0f) / inverseMatrix[14];
-
-		nearPlaneNormal = glm::normalize(glm::cross(e3, e2));
-		nearPlaneDistance = -glm::dot(nearPlaneNormal, inverseMatrix[3]);
-
-		farPlaneNormal = glm::normalize(glm::cross(e3, -e2));
-		farPlaneDistance = -glm::dot(farPlaneNormal, inverseMatrix[3]);
-	}
-};*/
-
-
-
-static bool lightIntersectsFrustum(GO_Camera* camera, const Sphere& bs, float w,
-	glm::vec4 leftBottomRightTop, glm::vec2 nearFar) {
-	if (bs.position.z + bs.radius / w < nearFar.x || bs.position.z - bs.radius / w > nearFar.y) {
-		return false;
-	}
-	glm::vec2 radius2D = glm::vec2(
-		camera->projectionParams.perspective.aspect, 1.0f)
-		* bs.radius / w;
-	//return true;
-	glm::vec2 pos2D = glm::vec2(bs.position) / w;
-	//pos2D = 0.5f * pos2D + 0.5f;
-	//float screen_height = 2.0f * tan(camera->projectionParams.perspective.fovy / 2.0f);
-	//float screen_width = screen_height * camera->projectionParams.perspective.aspect;
-	//glm::vec2 wndSizeAtDepth = viewSpacePos.z * glm::vec2(screen_width, screen_height);
-	//glm::vec2 radius2D = glm::vec2(bs.radius) / wndSizeAtDepth;
-	//// Just do 2D bounding box comparison
-	glm::vec4 lbrt = glm::vec4(pos2D.x - radius2D.x, pos2D.y - radius2D.y, pos2D.x + radius2D.x, pos2D.y + radius2D.y);
-	return !(
-		lbrt.x >= leftBottomRightTop.z ||
-		lbrt.z <= leftBottomRightTop.x ||
-		lbrt.y >= leftBottomRightTop.w ||
-		lbrt.w <= leftBottomRightTop.y
-		);
-}
-
-
-
-void RP_Forward_OpenGL::runTilesCPU(Scene* scene) {
-	GO_Camera* camera = scene->getActiveCamera().get();
-	if (camera == nullptr) {
-		return;
-	}
-	if (tileLightMapping.size() != (size_t)this->numTiles.x * this->numTiles.y * 2)
-		tileLightMapping.resize((size_t)this->numTiles.x * this->numTiles.y * 2);
-	this->lightsIndex.clear();
-
-	std::vector<GLint> tileLights;
-	tileLights.reserve(this->maxLightsPerTile);
-
-	glm::vec2 nearFar = glm::vec2(
-		camera->projectionParams.perspective.near,
-		camera->projectionParams.perspective.far
-	);
-
-	lightVolumes.clear();
-	for (GO_Light* light : scene->lights) {
-		Sphere s;
-		s = light->getBoundingSphere();
-		glm::vec4 p = camera->getProjectionMatrix() * camera->getViewMatrix() * glm::vec4(s.position, 1.0f);
-		s.position = glm::vec3(p);
-		lightVolumes.push_back(std::pair<Sphere, float>(s, p.w));
-	}
-
-	// For each tile
-	for (size_t y = 0; y < this->numTiles.y; y++) {
-		for (size_t x = 0; x < this->numTiles.x; x++) {
-
-			glm::vec4 tileBounds = glm::vec4(
-				(float)x / (float)this->numTiles.x,
-				(float)y / (float)this->numTiles.y,
-				(float)(x + 1) / (float)this->numTiles.x,
-				(float)(y + 1) / (float)this->numTiles.y
-			);
-			tileLights.clear();
-
-			// For each light
-			for (GLint i = 0; i < (GLint)scene->lights.size(); i++) {
-				GO_Light* light = scene->lights[i];
-
-				// Detect if light intersects tile:
-				auto lv = lightVolumes[i];
-				if (light->type != GO_Light::Type::Point ||
-					lightIntersectsFrustum(camera, lv.first, lv.second, tileBounds, nearFar)) {
-					tileLights.push_back(i);
-				}
-
-			}
-
-			// Append the tile's lights to the global list and record indices.
-			this->tileLightMapping[2 * (y * this->numTiles.x + x)] = (GLint)this->lightsIndex.size();
-			this->tileLightMapping[2 * (y * this->numTiles.x + x) + 1] = (GLint)tileLights.size();
-			this->lightsIndex.insert(this->lightsIndex.end(), tileLights.begin(), tileLights.end());
-
-		}
-	}
-
-	this->updateTileLightMappingSSBO();
-	this->updateLightsIndexSSBO();
-
-}
-
-void RP_Forward_OpenGL::runClustersCPU(Scene* scene) {
-
-}
-
-
-
-
-
-
-void RP_Forward_OpenGL::updateClustersSSBO(Scene* scene) {
-	GO_Camera* camera = scene->getActiveCamera().get();
-	if (!camera)
-		return;
-	if (this->clustersSSBO == 0 || this->clustersRes != this->numTiles) {
-		if (this->clustersSSBO != 0)
-			glDeleteBuffers(1, &this->clustersSSBO);
-		glGenBuffers(1, &this->clustersSSBO);
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->clustersSSBO);
-		GLsizeiptr size = sizeof(glm::vec4) * this->numTiles.x * this->numTiles.y * this->numTiles.z * 2;
-		glBufferData(GL_SHADER_STORAGE_BUFFER, size, (void*)0, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, this->clustersSSBOBinding, this->clustersSSBO);
-		this->clustersRes = this->numTiles;
-		std::cout << "REALLOCATING clustersSSBO\n";
-		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-
-		// Load the compute shader if we haven't already
-		if (this->clusterGenShader.getID() == 0) {
-			this->clusterGenShader.readCompute(
-				"shaders/opengl/clustersgen.glsl"
-			);
-		}
-		this->clusterGenShader.bind();
-		this->clusterGenShader.setUniform1f("zNear", camera->projectionParams.perspective.near);
-		this->clusterGenShader.setUniform1f("zFar", camera->projectionParams.perspective.far);
-		glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
-		this->clusterGenShader.setUniformMat4("inverseProjection", invProj);
-		glDispatchCompute((GLuint)this->numTiles.x, (GLuint)this->numTiles.y, (GLuint)this->numTiles.z);
-		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-	}
-}
-
-
-
-
-
-void RP_Forward_OpenGL::runClustersGPU(Scene* scene) {
-	// Also runs cluster AABB gen compute shader if needed.
-	this->updateClustersSSBO(scene);
-	// The next two just make sure the buffers are sufficiently large.
-	this->updateLightsIndexSSBO();
-	this->updateTileLightMappingSSBO();
-
-	if (this->clusterCullLightsShader.getID() == 0) {
-		this->clusterCullLightsShader.readCompute(
-			"shaders/opengl/clusterscull2.glsl"
-		);
-	}
-	this->clusterCullLightsShader.bind();
-	//glDispatchCompute(1, 1, 1);
-	glDispatchCompute((GLuint)this->numTiles.x, (GLuint)this->numTiles.y, (GLuint)this->numTiles.z);
-	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->tileLightMappingSSBO);
-	//GLint* buf = (GLint*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-	//std::cout << "BEGIN GRID BUFFER\n";
-	//for (int i = 0; i < this->numTiles.x * this->numTiles.y * this->numTiles.z * 2; i++) {
-	//	std::cout << buf[i] << " ";
-	//}
-	//std::cout << "END GRID BUFFER\n";
-	//glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->lightsIndexSSBO);
-	//buf = (GLint*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-	//std::cout << "BEGIN INDEX BUFFER\n";
-	//for (int i = 0; i < lightsIndexSSBOSize; i++) {
-	//	std::cout << buf[i] << " ";
-	//}
-	//std::cout << "END INDEX BUFFER\n";
-	//glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->globalIndexCountSSBO);
-	//GLuint* buf = (GLuint*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-	//std::cout << "GLOBAL INDEX: " << *buf << "\n";
-	//glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
-	//glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-}
-
+json RP_Forward_OpenGL::takeCullingStats() {
+	return this->lightCulling.takeCullingStats();
+}
\ No newline at end of file
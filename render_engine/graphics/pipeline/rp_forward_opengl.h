@@ -2,6 +2,7 @@
 #include "graphics/pipeline/rp_forward.h"
 #include "graphics/graphics_opengl.h"
 #include "geometry/sphere.h"
+#include "graphics/pipeline/lightculling_opengl.h"
 
 
 class RP_Forward_OpenGL : public RP_Forward {
@@ -21,19 +22,7 @@ public:
 		Ref<Material> material) override;
 
 
-	// Indices should align with values in forward.frag.
-	enum class LightCulling : GLint {
-		None = 0,
-		BoundingSphere = 1,
-		TiledCPU = 3,
-		ClusteredCPU = 4,
-		TiledGPU = 5,
-		ClusteredGPU = 6,
-	};
-	LightCulling culling = LightCulling::None;
-	// (X,Y,Z) For tiled (instead of clustered), third element should be 1.
-	glm::ivec3 numTiles = glm::ivec3(80, 45, 32);
-	GLint maxLightsPerTile = 64;
+	virtual json takeCullingStats() override;
 
 
 private:
@@ -49,50 +38,8 @@ private:
 
 	GLuint postFBO = 0;
 	GLuint postTex = 0;
-	GLuint postDepthRB = 0;
+	GLuint postDepthTex = 0;
 
-	GLuint lightsSSBO = 0;
-	size_t lightsSSBONumLights = 0;
-	static constexpr GLuint lightsSSBOBinding = 0;		// Must align with deferred_light.frag
-	void updateLightsSSBO(Scene* scene, glm::mat4 viewMatrix);
-
-
-	// The SSBO storing mappings to ranges in lightsIndexSSBO (2 values per cluster, pos and len)
-	GLuint tileLightMappingSSBO = 0;
-	glm::ivec3 tileLightMappingRes;			// The resolution allocated. For tiles, z=1.
-	std::vector<GLint> tileLightMapping;	// When using CPU, stores values to be copied into SSBO.
-	static constexpr GLuint tileLightMappingSSBOBinding = 1;		// Must align with deferred_light.frag
-	void updateTileLightMappingSSBO();		// Checks size and, if CPU, copies values from tileLightMapping.
-
-
-	// The SSBO containing light lists for each cluster. tileLightMapping stores ranges in this list.
-	GLuint lightsIndexSSBO = 0;
-	size_t lightsIndexSSBOSize = 0;			// Size in bytes.
-	static constexpr GLuint lightsIndexSSBOBinding = 2;				// Must align with deferred_light.frag
-	std::vector<GLint> lightsIndex;			// When using CPU, stores values to be copied into SSBO.
-	GLuint globalIndexCountSSBO = 0;
-	static constexpr GLuint globalIndexCountSSBOBinding = 4;
-	void updateLightsIndexSSBO();			// Checks size and, if CPU, copies values from lightsIndex.
-
-
-	void runTilesCPU(Scene* scene);
-	void runClustersCPU(Scene* scene);
-
-	// Cache light volumes to avoid reallocating memory.
-	std::vector<std::pair<Sphere, float>> lightVolumes;
-
-
-
-
-	GLuint clustersSSBO = 0;
-	glm::ivec3 clustersRes;			// The resolution allocated. For tiles, z=1.
-	//std::vector<glm::vec4> clusters;	// Each cluster has 2 elements, min/max AABBs.
-	static constexpr GLuint clustersSSBOBinding = 3;		// Must align with deferred_light.frag
-	Shader_OpenGL clusterGenShader;
-	void updateClustersSSBO(Scene* scene);
-
-
-	Shader_OpenGL clusterCullLightsShader;
-
-	void runClustersGPU(Scene* scene);
+	// Shared with the other OpenGL pipelines; owned by Graphics_OpenGL.
+	LightCulling_OpenGL& lightCulling;
 };
\ No newline at end of file
@@ -10,8 +10,7 @@
 #include "objects/go_mesh.h"
 #include "utils/printutils.h"
 
-#include "graphics/pipeline/rp_deferred_opengl.h"
-#include "graphics/pipeline/rp_forward_opengl.h"
+#include "graphics/pipeline/lightculling_opengl.h"
 
 #include "nlohmann/json.hpp"
 using json = nlohmann::json;
@@ -51,7 +50,7 @@ public:
 
 
 
-void spawnLights(Scene* scene, size_t num_lights) {
+void spawnLights(Scene* scene, size_t num_lights, float spot_fraction, float static_fraction) {
 
     std::vector<GameObject*> lightSpawns;
 
@@ -104,7 +103,18 @@ void spawnLights(Scene* scene, size_t num_lights) {
         light->setPosition(pos);
         glm::vec3 color = glm::normalize(glm::vec3(random(), random(), random()));
         light->color = 6.0f * color;
-        light->addComponent<Moving>();
+        if (spot_fraction > 0.0f && random() < spot_fraction) {
+            // Aim roughly downwards so the cones land on the geometry below.
+            light->type = GO_Light::Type::Spot;
+            light->direction = glm::normalize(glm::vec3(random() - 0.5f, -1.0f, random() - 0.5f));
+            light->innerOuterAngles = glm::radians(glm::vec2(20.0f, 35.0f));
+        }
+        if (static_fraction > 0.0f && random() < static_fraction) {
+            light->isStatic = true;
+        }
+        else {
+            light->addComponent<Moving>();
+        }
         scene->addObject(light);
         if (make_atten_sphere) {
             Sphere bs = light->getBoundingSphere();
@@ -124,7 +134,7 @@ void spawnLights(Scene* scene, size_t num_lights) {
 }
 
 
-void setupDemoScene(Scene* scene, size_t num_lights) {
+void setupDemoScene(Scene* scene, size_t num_lights, float spot_fraction, float static_fraction, float light_cutoff, bool windowed_falloff) {
 
     scene->backgroundColor = 0.1f * glm::vec3(0.5f, 0.6f, 1.0f); //1.3f * glm::vec3(0.5f, 0.6f, 1.0f);
 
@@ -166,6 +176,8 @@ void setupDemoScene(Scene* scene, size_t num_lights) {
             if (L->type == GO_Light::Type::Directional) {
                 L->color *= 2.0f;
             }
+            // The scene's own lights never move.
+            L->isStatic = true;
             std::cout << "LIGHT: " << root->getName() << " | ";
             Utils::Print::vec3(root.cast<GO_Light>()->color);
         }
@@ -175,7 +187,15 @@ void setupDemoScene(Scene* scene, size_t num_lights) {
     };
     dim_the_lights(object);
 
-    spawnLights(scene, num_lights);
+    spawnLights(scene, num_lights, spot_fraction, static_fraction);
+
+    // Where the point & spot lights (imported and spawned) are cut off, and how.
+    for (GO_Light* light : scene->lights) {
+        if (light_cutoff > 0.0f) {
+            light->cutoff = light_cutoff;
+        }
+        light->windowedFalloff = windowed_falloff;
+    }
 
     std::cout << "Scene graph:\n";
     Utils::Print::objectTree(scene->getRoot().get());
@@ -194,9 +214,30 @@ int main(int argc, char* argv[]) {
     glm::ivec3 numTiles = glm::ivec3(48, 27, 24);
     GLint maxLightsPerTile = 128;
     size_t num_lights = 50;
+    float spot_fraction = 0.0f;
+    float static_fraction = 0.0f;
     std::filesystem::path log_file;
     std::filesystem::path render_dir;
     bool interactive = true;
+    bool bitset_lists = false;
+    bool compact_lists = false;
+    bool light_bvh = false;
+    bool sort_lights = false;
+    bool active_clusters = false;
+    bool pre_cull_lights = false;
+    LightCullingCPU::DepthSlicingMode depth_slicing = LightCullingCPU::DepthSlicingMode::Exponential;
+    float hybrid_split = -1.0f;
+    bool culling_stats = false;
+    bool measure_false_positives = false;
+    float incremental_margin = -1.0f;
+    bool async_culling = false;
+    bool async_culling_latency = false;
+    bool light_lod = false;
+    LightCullingCPU::LightLODSettings lod_settings;
+    bool static_light_grid = false;
+    LightCullingCPU::StaticLightGridSettings static_grid_settings;
+    float light_cutoff = -1.0f;
+    bool windowed_falloff = false;
 
     srand(1);
 
@@ -212,6 +253,16 @@ int main(int argc, char* argv[]) {
                 argsError();
             num_lights = std::stoi(args[++i]);
         }
+        else if (args[i] == "--spotLights") {
+            if (++i == args.size())
+                argsError();
+            spot_fraction = std::stof(args[i]);
+        }
+        else if (args[i] == "--staticLights") {
+            if (++i == args.size())
+                argsError();
+            static_fraction = std::stof(args[i]);
+        }
         else if (args[i] == "--pipeline") {
             if (++i == args.size())
                 argsError();
@@ -227,7 +278,9 @@ int main(int argc, char* argv[]) {
                 args[i] == "deferred-tiled-cpu" ||
                 args[i] == "deferred-clustered-cpu" ||
                 args[i] == "deferred-tiled-gpu" ||
-                args[i] == "deferred-clustered-gpu") {
+                args[i] == "deferred-clustered-gpu" ||
+                args[i] == "deferred-binned-cpu" ||
+                args[i] == "deferred-zbinned") {
                 pipeline = RenderPipelineType::Deferred;
             }
             else if (args[i] == "forward-none" ||
@@ -235,7 +288,9 @@ int main(int argc, char* argv[]) {
                 args[i] == "forward-tiled-cpu" ||
                 args[i] == "forward-clustered-cpu" ||
                 args[i] == "forward-tiled-gpu" ||
-                args[i] == "forward-clustered-gpu") {
+                args[i] == "forward-clustered-gpu" ||
+                args[i] == "forward-binned-cpu" ||
+                args[i] == "forward-zbinned") {
                 pipeline = RenderPipelineType::Forward;
             }
             else argsError();
@@ -257,6 +312,94 @@ int main(int argc, char* argv[]) {
                 argsError();
             maxLightsPerTile = (GLint)std::stoi(args[i]);
         }
+        else if (args[i] == "--bitsetLists") {
+            bitset_lists = true;
+        }
+        else if (args[i] == "--compactLists") {
+            compact_lists = true;
+        }
+        else if (args[i] == "--lightBVH") {
+            light_bvh = true;
+        }
+        else if (args[i] == "--sortLights") {
+            sort_lights = true;
+        }
+        else if (args[i] == "--activeClusters") {
+            active_clusters = true;
+        }
+        else if (args[i] == "--preCullLights") {
+            pre_cull_lights = true;
+        }
+        else if (args[i] == "--depthSlicing") {
+            if (++i == args.size())
+                argsError();
+            if (args[i] == "exponential")
+                depth_slicing = LightCullingCPU::DepthSlicingMode::Exponential;
+            else if (args[i] == "linear")
+                depth_slicing = LightCullingCPU::DepthSlicingMode::Linear;
+            else if (args[i] == "hybrid")
+                depth_slicing = LightCullingCPU::DepthSlicingMode::Hybrid;
+            else if (args[i] == "adaptive")
+                depth_slicing = LightCullingCPU::DepthSlicingMode::Adaptive;
+            else
+                argsError();
+        }
+        else if (args[i] == "--hybridSplit") {
+            if (++i == args.size())
+                argsError();
+            hybrid_split = std::stof(args[i]);
+        }
+        else if (args[i] == "--cullingStats") {
+            culling_stats = true;
+        }
+        else if (args[i] == "--measureFalsePositives") {
+            culling_stats = true;
+            measure_false_positives = true;
+        }
+        else if (args[i] == "--incremental") {
+            if (++i == args.size())
+                argsError();
+            incremental_margin = std::stof(args[i]);
+        }
+        else if (args[i] == "--asyncCulling") {
+            async_culling = true;
+        }
+        else if (args[i] == "--asyncCullingLatency") {
+            async_culling = true;
+            async_culling_latency = true;
+        }
+        else if (args[i] == "--lightLOD") {
+            light_lod = true;
+        }
+        else if (args[i] == "--lodScreenSize") {
+            if (++i == args.size())
+                argsError();
+            light_lod = true;
+            lod_settings.screenSize = std::stof(args[i]);
+        }
+        else if (args[i] == "--lodError") {
+            if (++i == args.size())
+                argsError();
+            light_lod = true;
+            lod_settings.errorBudget = std::stof(args[i]);
+        }
+        else if (args[i] == "--staticLightGrid") {
+            static_light_grid = true;
+        }
+        else if (args[i] == "--staticGridCellSize") {
+            if (++i == args.size())
+                argsError();
+            static_light_grid = true;
+            static_grid_settings.cellSize = std::stof(args[i]);
+        }
+        else if (args[i] == "--lightCutoff") {
+            if (++i == args.size())
+                argsError();
+            light_cutoff = std::stof(args[i]);
+        }
+        else if (args[i] == "--windowedFalloff") {
+            windowed_falloff = true;
+        }
         else if (args[i] == "--log-file") {
             if (++i == args.size())
                 argsError();
@@ -279,60 +422,59 @@ int main(int argc, char* argv[]) {
     }
 
     engine.getGraphics()->setRenderPipeline(pipeline);
-    RenderPipeline* gpipeline = engine.getGraphics()->getRenderPipeline();
-    if (pipeline_name == "deferred-none")
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::None;
-    else if (pipeline_name == "deferred-boundingsphere")
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::BoundingSphere;
-    else if (pipeline_name == "deferred-rastersphere")
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::RasterSphere;
-    else if (pipeline_name == "deferred-tiled-cpu") {
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::TiledCPU;
-        numTiles.z = 1;     // IMPORTANT.
-        ((RP_Deferred_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Deferred_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "deferred-clustered-cpu") {
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::ClusteredCPU;
-        ((RP_Deferred_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Deferred_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "deferred-tiled-gpu") {
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::TiledGPU;
-        numTiles.z = 1;     // IMPORTANT.
-        ((RP_Deferred_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Deferred_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "deferred-clustered-gpu") {
-        ((RP_Deferred_OpenGL*)gpipeline)->culling = RP_Deferred_OpenGL::LightCulling::ClusteredGPU;
-        ((RP_Deferred_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Deferred_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "forward-none")
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::None;
-    else if (pipeline_name == "forward-boundingsphere")
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::BoundingSphere;
-    else if (pipeline_name == "forward-tiled-cpu") {
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::TiledCPU;
-        numTiles.z = 1;     // IMPORTANT.
-        ((RP_Forward_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Forward_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "forward-clustered-cpu") {
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::ClusteredCPU;
-        ((RP_Forward_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Forward_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "forward-tiled-gpu") {
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::TiledGPU;
-        numTiles.z = 1;     // IMPORTANT.
-        ((RP_Forward_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Forward_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
-    }
-    else if (pipeline_name == "forward-clustered-gpu") {
-        ((RP_Forward_OpenGL*)gpipeline)->culling = RP_Forward_OpenGL::LightCulling::ClusteredGPU;
-        ((RP_Forward_OpenGL*)gpipeline)->numTiles = numTiles;
-        ((RP_Forward_OpenGL*)gpipeline)->maxLightsPerTile = maxLightsPerTile;
+    if (pipeline == RenderPipelineType::Deferred || pipeline == RenderPipelineType::Forward) {
+        // Both pipelines shade from the same light culling, so it's configured once.
+        LightCulling_OpenGL& lightCulling = ((Graphics_OpenGL*)engine.getGraphics())->getLightCulling();
+        using LightCulling = LightCulling_OpenGL::LightCulling;
+        // The pipeline name is "<deferred|forward>-<culling>".
+        std::string culling_name = pipeline_name.substr(pipeline_name.find('-') + 1);
+        if (culling_name == "none")
+            lightCulling.culling = LightCulling::None;
+        else if (culling_name == "boundingsphere")
+            lightCulling.culling = LightCulling::BoundingSphere;
+        else if (culling_name == "rastersphere")
+            lightCulling.culling = LightCulling::RasterSphere;
+        else if (culling_name == "tiled-cpu") {
+            lightCulling.culling = LightCulling::TiledCPU;
+            numTiles.z = 1;     // IMPORTANT.
+        }
+        else if (culling_name == "clustered-cpu")
+            lightCulling.culling = LightCulling::ClusteredCPU;
+        else if (culling_name == "binned-cpu")
+            lightCulling.culling = LightCulling::BinnedCPU;
+        else if (culling_name == "zbinned")
+            lightCulling.culling = LightCulling::ZBinned;
+        else if (culling_name == "tiled-gpu") {
+            lightCulling.culling = LightCulling::TiledGPU;
+            numTiles.z = 1;     // IMPORTANT.
+        }
+        else if (culling_name == "clustered-gpu")
+            lightCulling.culling = LightCulling::ClusteredGPU;
+        lightCulling.numTiles = numTiles;
+        lightCulling.maxLightsPerTile = maxLightsPerTile;
+
+        if (bitset_lists)
+            lightCulling.lightListFormat = LightCulling_OpenGL::LightListFormat::Bitset;
+        lightCulling.compactGPULists = compact_lists;
+        lightCulling.lightBVH = light_bvh;
+        lightCulling.sortLights = sort_lights;
+        lightCulling.activeClusters = active_clusters;
+        lightCulling.preCullLights = pre_cull_lights;
+        lightCulling.depthSlicingMode = depth_slicing;
+        if (hybrid_split > 0.0f)
+            lightCulling.hybridSplitDepth = hybrid_split;
+        lightCulling.collectCullingStats = culling_stats;
+        lightCulling.measureFalsePositives = measure_false_positives;
+        if (incremental_margin >= 0.0f) {
+            lightCulling.incrementalBinning = true;
+            lightCulling.incrementalMargin = incremental_margin;
+        }
+        lightCulling.asyncCulling = async_culling;
+        lightCulling.asyncCullingLatency = async_culling_latency;
+        lightCulling.lightLOD = light_lod;
+        lightCulling.lightLODSettings = lod_settings;
+        lightCulling.staticLightGrid = static_light_grid;
+        lightCulling.staticLightGridSettings = static_grid_settings;
     }
 
     std::cout << "lights: " << num_lights << "\n";
@@ -340,7 +482,7 @@ int main(int argc, char* argv[]) {
 
 
     Ref<Scene> scene = engine.createScene();
-    setupDemoScene(scene.get(), num_lights);
+    setupDemoScene(scene.get(), num_lights, spot_fraction, static_fraction, light_cutoff, windowed_falloff);
     engine.setActiveScene(scene);
 
     if (interactive) {
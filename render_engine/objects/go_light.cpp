@@ -1,6 +1,8 @@
 #include "objects/go_light.h"
 #include "core/scene.h"
 
+#include <limits>
+
 
 
 GO_Light::GO_Light(GameObjectID id, RenderEngine* engine)
@@ -31,12 +33,50 @@ glm::vec3 GO_Light::getWorldSpaceDirection() {
 }
 
 
-Sphere GO_Light::getBoundingSphere(float thresh) {
-	// A = color / (atten * r^2)
-	// r = sqrt(len(color) / (A * atten))
+float GO_Light::getRange() {
+	if (this->color == this->rangeColor && this->attenuation == this->rangeAttenuation && this->cutoff == this->rangeCutoff) {
+		return this->range;
+	}
+	this->rangeColor = this->color;
+	this->rangeAttenuation = this->attenuation;
+	this->rangeCutoff = this->cutoff;
+
+	// color / (c + l*r + q*r^2) = cutoff
+	// q*r^2 + l*r + (c - color / cutoff) = 0
 	float color = std::max(std::max(this->color.r, this->color.g), this->color.b);
-	float atten = this->attenuation.z;
+	float c = this->attenuation.x;
+	float l = this->attenuation.y;
+	float q = this->attenuation.z;
+	float k = c - color / this->cutoff;
+	if (!(k < 0.0f)) {
+		// Already below the cutoff at the light.
+		this->range = 0.0f;
+	}
+	else if ((l <= 0.0f && q <= 0.0f) || this->cutoff <= 0.0f) {
+		this->range = std::numeric_limits<float>::infinity();
+	}
+	else {
+		// The positive root, in the form that stays accurate for small q (and works for q = 0).
+		this->range = -2.0f * k / (l + sqrt(l * l - 4.0f * q * k));
+	}
+	return this->range;
+}
+
+Sphere GO_Light::getBoundingSphere() {
+	float range = this->getRange();
 	glm::mat modelMatrix = this->getModelMatrix();
 	glm::vec3 pos = modelMatrix[3];
-	return Sphere(sqrt(color / (thresh * atten)), pos);
+	float angle = this->innerOuterAngles.y;
+	if (this->type != Type::Spot || angle >= glm::radians(90.0f)) {
+		return Sphere(range, pos);
+	}
+	// The cone is the set of points within range of the apex and angle of the axis.
+	// Narrow cones: the sphere through the apex and the rim of the cap.
+	// Wide cones: the sphere around the rim, which then also holds the apex.
+	glm::vec3 dir = glm::normalize(this->getWorldSpaceDirection());
+	if (angle <= glm::radians(45.0f)) {
+		float radius = range / (2.0f * cos(angle));
+		return Sphere(radius, pos + radius * dir);
+	}
+	return Sphere(range * sin(angle), pos + range * cos(angle) * dir);
 }
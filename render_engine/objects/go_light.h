@@ -24,9 +24,10 @@ public:
 	Type type = Type::Point;
 
 	// Directional, Spot
-	glm::vec3 direction;
-	// Spot
-	glm::vec2 innerOuterAngles;
+	glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+	// Spot: inner & outer half-angles (radians) from the direction. Full intensity
+	// inside the inner angle, fading to nothing at the outer angle.
+	glm::vec2 innerOuterAngles = glm::vec2(0.0f);
 
 	// Color (may not be clamped).
 	glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -34,10 +35,33 @@ public:
 	// Attenuation parameters: (constant, linear, quadratic).
 	glm::vec3 attenuation = glm::vec3(0.0f, 0.0f, 2.0f);
 
+	// Intensity (brightest channel) at which the light is cut off. Point, Spot.
+	float cutoff = 0.02f;
+	// Point, Spot: fade the attenuation smoothly to zero at getRange(), rather than
+	// dropping from cutoff to nothing where the culling stops.
+	bool windowedFalloff = false;
+
+	// Point, Spot: the light never moves (and rarely changes), so LightCulling_OpenGL may
+	// bin it once into its static light grid rather than cull it every frame.
+	bool isStatic = false;
+
 
 	glm::vec3 getWorldSpaceDirection();
 
-	// ASSUMES QUADRATIC ATTENUATION
-	Sphere getBoundingSphere(float thresh = 0.02f);
+	// Distance at which the light's intensity falls to cutoff, under the full
+	// (constant, linear, quadratic) attenuation. Infinite if it never does.
+	// Cached, and only recomputed when color, attenuation or cutoff change.
+	float getRange();
+
+	// For spot lights, the smallest sphere around the cone cut off at getRange().
+	Sphere getBoundingSphere();
+
+private:
+
+	// What the cached range was computed from.
+	glm::vec3 rangeColor = glm::vec3(-1.0f);
+	glm::vec3 rangeAttenuation = glm::vec3(-1.0f);
+	float rangeCutoff = -1.0f;
+	float range = 0.0f;
 
 };
\ No newline at end of file
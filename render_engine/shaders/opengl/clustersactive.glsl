@@ -0,0 +1,69 @@
+#version 430 core
+
+// ClusteredGPU with active clusters, pass 1: flags every cluster that holds at least
+// one visible pixel, from the depth buffer of the Z pre-pass (forward) or the gBuffer
+// pass (deferred). One invocation per pixel. clusterscompact.glsl then gathers the
+// flagged clusters and clears the flags for the next frame.
+#define GROUP_SIZE 16
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE, local_size_z = 1) in;
+
+
+uniform sampler2D depthTex;
+uniform ivec3 numTiles;
+uniform vec2 viewportSize;
+uniform float zNear;
+uniform float zFar;
+// (linearSlices, split, end, unused); see LightCullingCPU::DepthSlicing.
+uniform vec4 depthSlicing;
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 12) buffer activeClusterFlagsSSBO
+{
+    uint activeClusterFlags[];
+};
+
+
+// Same as LightCullingCPU::DepthSlicing::slice() and depthSlice() in the shading passes.
+uint depthSlice(float depth) {
+    int numSlices = numTiles.z;
+    int linearSlices = int(depthSlicing.x);
+    float k;
+    if (depth <= zNear) {
+        return 0u;
+    }
+    else if (depth < depthSlicing.y) {
+        k = float(linearSlices) * (depth - zNear) / (depthSlicing.y - zNear);
+    }
+    else if (linearSlices >= numSlices) {
+        return uint(numSlices - 1);
+    }
+    else {
+        k = float(linearSlices) + float(numSlices - linearSlices) * log2(depth / depthSlicing.y) / log2(depthSlicing.z / depthSlicing.y);
+    }
+    return uint(clamp(int(k), 0, numSlices - 1));
+}
+
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x >= int(viewportSize.x) || pixel.y >= int(viewportSize.y)) {
+        return;
+    }
+    float d = texelFetch(depthTex, pixel, 0).r;
+    if (d >= 1.0) {
+        return;
+    }
+    float ndc = 2.0 * d - 1.0;
+    float viewDepth = 2.0 * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+
+    uvec2 tile = uvec2(vec2(numTiles.xy) * (vec2(pixel) + 0.5) / viewportSize);
+    uint tileIndex = tile.y * uint(numTiles.x) + tile.x;
+    uint sliceSize = uint(numTiles.x * numTiles.y);
+    // The deferred pass shades from half-float positions, which can land in the
+    // neighbouring slice; flag both when the depth is that close to the boundary.
+    uint first = depthSlice(viewDepth * 0.999);
+    uint last = depthSlice(viewDepth * 1.001);
+    for (uint z = first; z <= last; ++z) {
+        activeClusterFlags[z * sliceSize + tileIndex] = 1u;
+    }
+}
\ No newline at end of file
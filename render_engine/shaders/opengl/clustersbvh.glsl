@@ -0,0 +1,229 @@
+#version 430 core
+
+// ClusteredGPU with the light BVH: one invocation per cluster, walking the BVH built
+// on the CPU (LightCullingCPU::buildLightBVH()) instead of testing every light, so
+// each cluster only tests the lights in the leaves it overlaps. Index lists only;
+// takes the same compactPass values and writes the same outputs as clusterscull3.glsl.
+// Must match clusterCullGroupSize in lightculling_opengl.h.
+#define GROUP_SIZE 64
+layout(local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+
+struct VolumeTileAABB {
+    vec4 minPoint;
+    vec4 maxPoint;
+};
+
+layout(std430, binding = 3) readonly buffer clusterAABB {
+    VolumeTileAABB cluster[];
+};
+
+
+// Must match LightBVHNode in lightculling_cpu.h. Nodes are depth-first: an inner
+// node's first child is the next node, and skip is the node after its subtree.
+struct LightBVHNode {
+    vec4 boundsMin;
+    vec4 boundsMax;
+    // (first light, light count (0 for inner nodes), skip, unused)
+    ivec4 firstCountSkip;
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 9) readonly buffer lightBVHSSBO
+{
+    // (number of nodes, number of lights in the leaves, number of unbounded lights, unused)
+    ivec4 bvhHeader;
+    LightBVHNode nodes[];
+};
+
+// Must match SSBOBVHLight in lightculling_opengl.cpp. The view-space volume of each light
+// in leaf order, followed by the unbounded lights (which touch every cluster).
+struct BVHLight {
+    vec4 sphere;
+    // (axis, cos of the outer angle). w < -1 for lights without a cone.
+    vec4 coneAxis;
+    // (apex, range)
+    vec4 coneApex;
+    // x: the light's index in lightsSSBO.
+    ivec4 lightIndex;
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 10) readonly buffer lightBVHLightsSSBO
+{
+    BVHLight bvhLights[];
+};
+
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 1) buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 2) writeonly buffer lightsIndexSSBO
+{
+    int lightsIndex[];
+};
+
+// Must be zeroed before the dispatch.
+layout(std430, binding = 4) buffer globalIndexCountSSBO {
+    uint globalIndexCount;
+};
+
+uniform int numClusters;
+// Size of lightsIndex in ints. Lists are truncated rather than written past the end.
+uniform int lightsIndexCapacity;
+// Stats for clustersstats.glsl; only bound when recordOverflow is 1.
+layout(std430, binding = 7) buffer statsSSBO
+{
+    uint overflowingClusters;
+};
+uniform int recordOverflow;
+
+// 0: count and pack in one dispatch with atomics.
+// 1: count only. 2: fill at the offsets from clustersscan.glsl.
+uniform int compactPass;
+
+// Active clusters only: the cluster IDs from clusterscompact.glsl (see clusterscull3.glsl), with the dispatch
+// sized indirectly to cover them.
+layout(std430, binding = 13) readonly buffer activeClustersSSBO
+{
+    uvec3 activeDispatchSize;
+    uint numActive;
+    uint activeClusterIds[];
+};
+uniform int activeOnly;
+
+shared uint groupCount;
+shared uint groupOffset;
+
+
+// Same as coneTouchesSphere() in clusterscull3.glsl.
+bool coneTouchesSphere(vec4 coneAxis, vec4 coneApex, vec4 sphere) {
+    vec3 v = sphere.xyz - coneApex.xyz;
+    float alongAxis = dot(v, coneAxis.xyz);
+    float coneSin = sqrt(max(1.0 - coneAxis.w * coneAxis.w, 0.0));
+    float distToCone = coneAxis.w * sqrt(max(dot(v, v) - alongAxis * alongAxis, 0.0)) - alongAxis * coneSin;
+    return !(distToCone > sphere.w || alongAxis > sphere.w + coneApex.w || alongAxis < -sphere.w);
+}
+
+// Same as lightTouchesCluster() in lightculling_cpu.cpp.
+bool lightTouchesCluster(BVHLight light, VolumeTileAABB aabb, vec4 clusterSphere) {
+    vec3 d = max(max(aabb.minPoint.xyz - light.sphere.xyz, light.sphere.xyz - aabb.maxPoint.xyz), 0.0);
+    if (dot(d, d) > light.sphere.w * light.sphere.w) {
+        return false;
+    }
+    return light.coneAxis.w < -1.0 || coneTouchesSphere(light.coneAxis, light.coneApex, clusterSphere);
+}
+
+// Finds the cluster's lights. With write, stores up to writable of them from offset
+// and returns how many were stored; otherwise just counts them.
+uint walkLights(uint clusterIndex, bool write, uint offset, uint writable) {
+    VolumeTileAABB aabb = cluster[clusterIndex];
+    vec4 clusterSphere = vec4(
+        0.5 * (aabb.minPoint.xyz + aabb.maxPoint.xyz),
+        0.5 * length(aabb.maxPoint.xyz - aabb.minPoint.xyz)
+    );
+    uint found = 0u;
+
+    int numLeafLights = bvhHeader.y;
+    for (int j = 0; j < bvhHeader.z; ++j) {
+        if (write && found == writable) {
+            return found;
+        }
+        if (write) {
+            lightsIndex[offset + found] = bvhLights[numLeafLights + j].lightIndex.x;
+        }
+        found++;
+    }
+
+    int n = 0;
+    while (n < bvhHeader.x) {
+        LightBVHNode node = nodes[n];
+        if (any(greaterThan(node.boundsMin.xyz, aabb.maxPoint.xyz)) ||
+            any(lessThan(node.boundsMax.xyz, aabb.minPoint.xyz))) {
+            n = node.firstCountSkip.z;
+            continue;
+        }
+        int end = node.firstCountSkip.x + node.firstCountSkip.y;
+        for (int k = node.firstCountSkip.x; k < end; ++k) {
+            BVHLight light = bvhLights[k];
+            if (!lightTouchesCluster(light, aabb, clusterSphere)) {
+                continue;
+            }
+            if (write && found == writable) {
+                return found;
+            }
+            if (write) {
+                lightsIndex[offset + found] = light.lightIndex.x;
+            }
+            found++;
+        }
+        // Inner nodes descend into their first child; leaves move on to skip.
+        n++;
+    }
+    return found;
+}
+
+
+void main() {
+    uint clusterIndex = gl_WorkGroupID.x * GROUP_SIZE + gl_LocalInvocationIndex;
+    // Out-of-range invocations still take part in the barriers.
+    bool active = clusterIndex < uint(numClusters);
+    if (activeOnly == 1) {
+        active = clusterIndex < numActive;
+        clusterIndex = active ? activeClusterIds[clusterIndex] : 0u;
+    }
+    uint capacity = uint(lightsIndexCapacity);
+
+    if (compactPass == 2) {
+        // Fill at the scanned offsets. The buffer is sized from an earlier frame's
+        // total, so it can still be too small; clamp instead of overflowing.
+        if (!active) {
+            return;
+        }
+        uint offset = uint(tileLightMapping[2 * clusterIndex]);
+        uint count = uint(tileLightMapping[2 * clusterIndex + 1]);
+        uint writable = offset < capacity ? min(count, capacity - offset) : 0u;
+        uint written = walkLights(clusterIndex, true, offset, writable);
+        tileLightMapping[2 * clusterIndex + 1] = int(written);
+        if (recordOverflow == 1 && written < count) {
+            atomicAdd(overflowingClusters, 1u);
+        }
+        return;
+    }
+
+    uint count = active ? walkLights(clusterIndex, false, 0u, 0u) : 0u;
+    if (compactPass == 1) {
+        if (active) {
+            tileLightMapping[2 * clusterIndex + 1] = int(count);
+        }
+        return;
+    }
+
+    // Reserve space in lightsIndex: first within the workgroup, then one global
+    // atomic per workgroup.
+    if (gl_LocalInvocationIndex == 0) {
+        groupCount = 0u;
+    }
+    barrier();
+    uint localOffset = atomicAdd(groupCount, count);
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        groupOffset = atomicAdd(globalIndexCount, groupCount);
+    }
+    barrier();
+    uint offset = groupOffset + localOffset;
+    uint writable = offset < capacity ? min(count, capacity - offset) : 0u;
+
+    if (active) {
+        uint written = walkLights(clusterIndex, true, offset, writable);
+        tileLightMapping[2 * clusterIndex] = int(offset);
+        tileLightMapping[2 * clusterIndex + 1] = int(written);
+        if (recordOverflow == 1 && written < count) {
+            atomicAdd(overflowingClusters, 1u);
+        }
+    }
+}
\ No newline at end of file
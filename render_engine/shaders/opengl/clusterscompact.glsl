@@ -0,0 +1,89 @@
+#version 430 core
+
+// ClusteredGPU with active clusters, pass 2: one invocation per cluster. Appends the
+// flagged clusters to activeClusterIds and sizes the indirect dispatch of the culling
+// passes to cover them. Clusters that aren't flagged get an empty light list, since
+// the culling passes no longer visit them, and every flag is cleared for the next frame.
+// Also the workgroup size of the culling passes, which the indirect dispatch is sized for.
+// Must match clusterCullGroupSize in lightculling_opengl.h.
+#define GROUP_SIZE 64
+layout(local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 12) buffer activeClusterFlagsSSBO
+{
+    uint activeClusterFlags[];
+};
+
+// Binding must align with lightculling_opengl.h
+// Also the GL_DISPATCH_INDIRECT_BUFFER of the culling passes. The header is reset
+// to (0, 1, 1, 0) before the dispatch.
+layout(std430, binding = 13) buffer activeClustersSSBO
+{
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+    uint numActive;
+    uint activeClusterIds[];
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 1) writeonly buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// 0: index lists, 1: bitsets (see LightListFormat in lightculling_opengl.h)
+uniform int listFormat;
+uniform int numClusters;
+uniform int numLights;
+
+shared uint groupCount;
+shared uint groupOffset;
+
+
+void main() {
+    uint clusterIndex = gl_WorkGroupID.x * GROUP_SIZE + gl_LocalInvocationIndex;
+    bool inRange = clusterIndex < uint(numClusters);
+    bool flagged = false;
+    if (inRange) {
+        flagged = activeClusterFlags[clusterIndex] != 0u;
+        activeClusterFlags[clusterIndex] = 0u;
+        if (!flagged) {
+            if (listFormat == 1) {
+                uint numSummaryWords = ((uint(numLights) + 31) / 32 + 31) / 32;
+                for (uint s = 0; s < numSummaryWords; ++s) {
+                    tileLightMapping[clusterIndex * numSummaryWords + s] = 0;
+                }
+            }
+            else {
+                tileLightMapping[2 * clusterIndex] = 0;
+                tileLightMapping[2 * clusterIndex + 1] = 0;
+            }
+        }
+    }
+
+    // Reserve slots within the workgroup, then once globally, so the IDs of a
+    // workgroup stay in order and next to each other.
+    if (gl_LocalInvocationIndex == 0) {
+        groupCount = 0u;
+    }
+    barrier();
+    uint localOffset = flagged ? atomicAdd(groupCount, 1u) : 0u;
+    barrier();
+    if (gl_LocalInvocationIndex == 0 && groupCount > 0u) {
+        groupOffset = atomicAdd(numActive, groupCount);
+        // Each workgroup adds the culling groups its range starts, so the total
+        // ends up as ceil(numActive / GROUP_SIZE).
+        uint end = groupOffset + groupCount;
+        uint groups = (end + GROUP_SIZE - 1) / GROUP_SIZE - (groupOffset + GROUP_SIZE - 1) / GROUP_SIZE;
+        if (groups > 0u) {
+            atomicAdd(dispatchX, groups);
+        }
+    }
+    barrier();
+    if (flagged) {
+        activeClusterIds[groupOffset + localOffset] = clusterIndex;
+    }
+}
\ No newline at end of file
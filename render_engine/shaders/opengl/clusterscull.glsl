@@ -12,12 +12,12 @@ struct Light {
     vec4 positionType;			// vec4
     // Normalized direction for point and spot lights.
     vec4 direction;				// vec3
-    // Inner & outer angles (radians) for spot lights.
-    vec4 innerOuterAngles;		// vec2
+    // Inner & outer angles (radians) for spot lights, then 1 if the falloff is windowed.
+    vec4 innerOuterAngles;		// vec3
     // Color.
     vec4 color;					// vec3
-    // Attenuation: (constant, linear, quadratic).
-    vec4 attenuation;			// vec3
+    // Attenuation: (constant, linear, quadratic), then the range (GO_Light::getRange()).
+    vec4 attenuation;			// vec4
 };
 
 
@@ -126,11 +126,8 @@ void main() {
 
 // pos: vec3, radius float
 vec4 getBoundingSphere(Light light) {
-    const float thresh = 0.02f;
-    // See computation in go_light.cpp
-    float color = max(max(light.color.r, light.color.g), light.color.b);
-    float atten = light.attenuation.z;
-    float rad = sqrt(color / (thresh * atten));
+    // Computed once per light on the CPU, see GO_Light::getRange().
+    float rad = light.attenuation.w;
     return vec4(light.positionType.xyz, rad);
 }
 
@@ -0,0 +1,451 @@
+#version 430 core
+
+// One invocation per cluster. The workgroup stages each batch of GROUP_SIZE lights
+// in shared memory once, so every light is read from the light buffer once per
+// workgroup instead of once per cluster.
+// Must match clusterCullGroupSize in lightculling_opengl.h.
+#define GROUP_SIZE 64
+layout(local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+
+
+// Light parameters.
+// We always use vec4 to avoid common alignment bugs in the OpenGL drivers
+struct Light {
+    // Position (xyz) and type (w).
+    // Type matches the enum in go_light.h.
+    // None=0, Dir=1, Point=2, Spot=3.
+    vec4 positionType;			// vec4
+    // Normalized direction for point and spot lights.
+    vec4 direction;				// vec3
+    // Inner & outer angles (radians) for spot lights, then 1 if the falloff is windowed.
+    vec4 innerOuterAngles;		// vec3
+    // Color.
+    vec4 color;					// vec3
+    // Attenuation: (constant, linear, quadratic), then the range (GO_Light::getRange()).
+    vec4 attenuation;			// vec4
+};
+
+
+struct VolumeTileAABB {
+    vec4 minPoint;
+    vec4 maxPoint;
+};
+
+layout(std430, binding = 3) readonly buffer clusterAABB {
+    VolumeTileAABB cluster[];
+};
+
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 0) readonly buffer lightBuffer
+{
+    // 4 elements to avoid alignment issues. Only use the first one.
+    ivec4 numLights;
+    vec4 lightData[];
+};
+Light getLightData(int idx) {
+    Light l;
+    int offset = idx * 5;
+    l.positionType = lightData[offset + 0];
+    l.direction = lightData[offset + 1];
+    l.innerOuterAngles = lightData[offset + 2];
+    l.color = lightData[offset + 3];
+    l.attenuation = lightData[offset + 4];
+    return l;
+}
+
+
+// Binding must align with lightculling_opengl.h
+// (offset, count) per cluster, or the summary mask with bitset lists.
+layout(std430, binding = 1) buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 2) writeonly buffer lightsIndexSSBO
+{
+    int lightsIndex[];
+};
+
+// Must be zeroed before the dispatch.
+layout(std430, binding = 4) buffer globalIndexCountSSBO {
+    uint globalIndexCount;
+};
+
+// 0: index lists, 1: bitsets (see LightListFormat in lightculling_opengl.h)
+uniform int listFormat;
+uniform int numClusters;
+// Size of lightsIndex in ints. Lists are truncated rather than written past the end.
+uniform int lightsIndexCapacity;
+// Stats for clustersstats.glsl; only bound when recordOverflow is 1.
+layout(std430, binding = 7) buffer statsSSBO
+{
+    uint overflowingClusters;
+};
+uniform int recordOverflow;
+
+// Index lists only. 0: count and pack in one dispatch with atomics.
+// 1: count only. 2: fill at the offsets from clustersscan.glsl.
+uniform int compactPass;
+
+// Active clusters only: the cluster IDs from clusterscompact.glsl, with the dispatch
+// sized indirectly to cover them.
+layout(std430, binding = 13) readonly buffer activeClustersSSBO
+{
+    uvec3 activeDispatchSize;
+    uint numActive;
+    uint activeClusterIds[];
+};
+uniform int activeOnly;
+
+// Cluster grid and projection, for the screen-rectangle and depth-range test.
+uniform ivec3 numTiles;
+uniform vec2 projScale;		// (proj[0][0], proj[1][1])
+uniform float zNear;
+uniform float zFar;
+// (linearSlices, split, end, unused); see LightCullingCPU::DepthSlicing.
+uniform vec4 depthSlicing;
+
+// 1 if the lights were frustum-culled on the CPU (LightCullingCPU::preCullLights()).
+// Each light in lightBuffer then comes with the inclusive (min, max) cluster range it
+// can touch, which replaces the screen-rectangle and depth-range test.
+uniform int preCulled;
+layout(std430, binding = 15) readonly buffer lightRangesSSBO
+{
+    ivec4 lightRanges[];	// (min xyz, unused), (max xyz, unused) per light.
+};
+
+
+// View-space bounding spheres of the current batch. w < 0 marks lights without
+// a bounded volume, which touch every cluster.
+shared vec4 sharedSpheres[GROUP_SIZE];
+// Screen rectangles (left, bottom, right, top in [0,1]) and view depth ranges of
+// the same lights. Lights that can't be seen get an empty rectangle.
+shared vec4 sharedRects[GROUP_SIZE];
+shared vec2 sharedDepths[GROUP_SIZE];
+// With preCulled, the cluster ranges of the same lights instead.
+shared ivec4 sharedRangeMins[GROUP_SIZE];
+shared ivec4 sharedRangeMaxs[GROUP_SIZE];
+// Spot light cones: (axis, cos of the outer angle) and (apex, range). w < -1 in the
+// first marks lights without a cone (including spots of 90 degrees or more).
+shared vec4 sharedConeAxes[GROUP_SIZE];
+shared vec4 sharedConeApexes[GROUP_SIZE];
+shared uint groupCount;
+shared uint groupOffset;
+
+
+const float PI = 3.14159265358979323;
+
+// Computed once per light on the CPU, see GO_Light::getRange().
+float getRange(Light light) {
+    return light.attenuation.w;
+}
+
+// pos: vec3, radius float
+// For spot lights, the smallest sphere around the cone.
+vec4 getBoundingSphere(Light light) {
+    float rad = getRange(light);
+    float angle = light.innerOuterAngles.y;
+    if (light.positionType.w != 3.0 || angle >= 0.5 * PI) {
+        return vec4(light.positionType.xyz, rad);
+    }
+    vec3 dir = light.direction.xyz;
+    if (angle <= 0.25 * PI) {
+        float coneRad = rad / (2.0 * cos(angle));
+        return vec4(light.positionType.xyz + coneRad * dir, coneRad);
+    }
+    return vec4(light.positionType.xyz + rad * cos(angle) * dir, rad * sin(angle));
+}
+
+// Same as projectedSlopeRange() in lightculling_cpu.cpp: the range of x / depth
+// over one axis of the sphere, clipped to depth >= zNear.
+vec2 projectedSlopeRange(float c, float d0, float radius) {
+    float lenSq = c * c + d0 * d0;
+    float tangentLen = sqrt(lenSq - radius * radius);
+    vec2 range = vec2(1e30, -1e30);
+    for (int i = 0; i < 2; ++i) {
+        float side = i == 0 ? -1.0 : 1.0;
+        float x = tangentLen * (c * tangentLen - side * d0 * radius) / lenSq;
+        float depth = tangentLen * (d0 * tangentLen + side * c * radius) / lenSq;
+        if (depth >= zNear) {
+            range = vec2(min(range.x, x / depth), max(range.y, x / depth));
+        }
+    }
+    float nearOffset = zNear - d0;
+    if (abs(nearOffset) < radius) {
+        float halfChord = sqrt(radius * radius - nearOffset * nearOffset);
+        range = vec2(min(range.x, (c - halfChord) / zNear), max(range.y, (c + halfChord) / zNear));
+    }
+    return range;
+}
+
+// Same as projectSphere() in lightculling_cpu.cpp. Returns false if the sphere is
+// entirely outside [zNear, zFar].
+bool projectSphere(vec4 sphere, out vec4 rect, out vec2 depthRange) {
+    float depth = -sphere.z;
+    if (depth + sphere.w < zNear || depth - sphere.w > zFar) {
+        return false;
+    }
+    depthRange = vec2(max(depth - sphere.w, zNear), min(depth + sphere.w, zFar));
+    if (dot(sphere.xyz, sphere.xyz) <= sphere.w * sphere.w) {
+        rect = vec4(-1e30, -1e30, 1e30, 1e30);
+        return true;
+    }
+    vec2 xRange = projectedSlopeRange(sphere.x, depth, sphere.w);
+    vec2 yRange = projectedSlopeRange(sphere.y, depth, sphere.w);
+    rect = 0.5 * vec4(projScale * vec2(xRange.x, yRange.x), projScale * vec2(xRange.y, yRange.y)) + 0.5;
+    return true;
+}
+
+// Must be called by the whole workgroup (it contains barriers).
+void loadBatch(uint batchStart) {
+    uint lightIdx = batchStart + gl_LocalInvocationIndex;
+    vec4 sphere = vec4(0.0);
+    vec4 rect = vec4(1.0, 1.0, 0.0, 0.0);
+    vec2 depthRange = vec2(0.0);
+    vec4 coneAxis = vec4(0.0, 0.0, 0.0, -2.0);
+    vec4 coneApex = vec4(0.0);
+    ivec4 rangeMin = ivec4(1);
+    ivec4 rangeMax = ivec4(0);
+    if (lightIdx < uint(numLights.x)) {
+        Light light = getLightData(int(lightIdx));
+        if (light.positionType.w == 2.0 || light.positionType.w == 3.0) {
+            sphere = getBoundingSphere(light);
+            if (preCulled == 1) {
+                rangeMin = lightRanges[2 * lightIdx];
+                rangeMax = lightRanges[2 * lightIdx + 1];
+            }
+            else if (!projectSphere(sphere, rect, depthRange)) {
+                rect = vec4(1.0, 1.0, 0.0, 0.0);
+            }
+            if (light.positionType.w == 3.0 && light.innerOuterAngles.y < 0.5 * PI) {
+                coneAxis = vec4(light.direction.xyz, cos(light.innerOuterAngles.y));
+                coneApex = vec4(light.positionType.xyz, getRange(light));
+            }
+        }
+        else {
+            sphere = vec4(0.0, 0.0, 0.0, -1.0);
+        }
+    }
+    // Wait until everyone is done with the previous batch.
+    barrier();
+    sharedSpheres[gl_LocalInvocationIndex] = sphere;
+    sharedRects[gl_LocalInvocationIndex] = rect;
+    sharedDepths[gl_LocalInvocationIndex] = depthRange;
+    sharedRangeMins[gl_LocalInvocationIndex] = rangeMin;
+    sharedRangeMaxs[gl_LocalInvocationIndex] = rangeMax;
+    sharedConeAxes[gl_LocalInvocationIndex] = coneAxis;
+    sharedConeApexes[gl_LocalInvocationIndex] = coneApex;
+    barrier();
+}
+
+// Same as LightCullingCPU::DepthSlicing::sliceNear(): the near depth of slice k.
+float sliceNear(uint k) {
+    int linearSlices = int(depthSlicing.x);
+    if (k >= uint(numTiles.z)) {
+        return zFar;
+    }
+    if (int(k) < linearSlices) {
+        return zNear + (depthSlicing.y - zNear) * float(k) / float(linearSlices);
+    }
+    return depthSlicing.y * pow(depthSlicing.z / depthSlicing.y, float(int(k) - linearSlices) / float(numTiles.z - linearSlices));
+}
+
+// The cluster's screen rectangle and depth slice, matching LightCullingCPU::computeClusterAABBs().
+struct ClusterBounds {
+    VolumeTileAABB aabb;
+    vec4 sphere;			// Around the AABB, for the cone test.
+    vec4 rect;
+    vec2 depthRange;
+    ivec3 tile;
+};
+
+ClusterBounds getClusterBounds(uint clusterIndex) {
+    ClusterBounds bounds;
+    bounds.aabb = cluster[clusterIndex];
+    bounds.sphere = vec4(
+        0.5 * (bounds.aabb.minPoint.xyz + bounds.aabb.maxPoint.xyz),
+        0.5 * length(bounds.aabb.maxPoint.xyz - bounds.aabb.minPoint.xyz)
+    );
+    uvec3 tile = uvec3(
+        clusterIndex % uint(numTiles.x),
+        clusterIndex / uint(numTiles.x) % uint(numTiles.y),
+        clusterIndex / uint(numTiles.x * numTiles.y)
+    );
+    bounds.rect = vec4(vec2(tile.xy), vec2(tile.xy + 1u)) / vec4(numTiles.xy, numTiles.xy);
+    bounds.depthRange = vec2(sliceNear(tile.z), sliceNear(tile.z + 1u));
+    bounds.tile = ivec3(tile);
+    return bounds;
+}
+
+// Same as coneTouchesCluster() in lightculling_cpu.cpp: rejects the cluster's
+// bounding sphere if it is outside the cone's angle or wholly in front of or behind it.
+bool coneTouchesSphere(vec4 coneAxis, vec4 coneApex, vec4 sphere) {
+    vec3 v = sphere.xyz - coneApex.xyz;
+    float alongAxis = dot(v, coneAxis.xyz);
+    float coneSin = sqrt(max(1.0 - coneAxis.w * coneAxis.w, 0.0));
+    float distToCone = coneAxis.w * sqrt(max(dot(v, v) - alongAxis * alongAxis, 0.0)) - alongAxis * coneSin;
+    return !(distToCone > sphere.w || alongAxis > sphere.w + coneApex.w || alongAxis < -sphere.w);
+}
+
+// Screen rectangle and depth range (or the pre-culled cluster range) first; the AABB
+// test then trims the corners, and spot lights are also tested against their cone.
+bool lightTouchesCluster(uint i, ClusterBounds bounds) {
+    vec4 sphere = sharedSpheres[i];
+    if (sphere.w < 0.0) {
+        return true;
+    }
+    if (preCulled == 1) {
+        if (any(lessThan(bounds.tile, sharedRangeMins[i].xyz)) || any(greaterThan(bounds.tile, sharedRangeMaxs[i].xyz))) {
+            return false;
+        }
+    }
+    else {
+        vec4 rect = sharedRects[i];
+        vec2 depthRange = sharedDepths[i];
+        if (rect.x > bounds.rect.z || rect.z < bounds.rect.x || rect.y > bounds.rect.w || rect.w < bounds.rect.y ||
+            depthRange.x > bounds.depthRange.y || depthRange.y < bounds.depthRange.x) {
+            return false;
+        }
+    }
+    vec3 d = max(max(bounds.aabb.minPoint.xyz - sphere.xyz, sphere.xyz - bounds.aabb.maxPoint.xyz), 0.0);
+    if (dot(d, d) > sphere.w * sphere.w) {
+        return false;
+    }
+    vec4 coneAxis = sharedConeAxes[i];
+    return coneAxis.w < -1.0 || coneTouchesSphere(coneAxis, sharedConeApexes[i], bounds.sphere);
+}
+
+// Both must be called by the whole workgroup.
+uint countLights(bool active, ClusterBounds bounds) {
+    uint lightCount = uint(numLights.x);
+    uint count = 0;
+    for (uint batch = 0; batch < lightCount; batch += GROUP_SIZE) {
+        loadBatch(batch);
+        if (active) {
+            uint batchSize = min(uint(GROUP_SIZE), lightCount - batch);
+            for (uint i = 0; i < batchSize; ++i) {
+                count += uint(lightTouchesCluster(i, bounds));
+            }
+        }
+    }
+    return count;
+}
+
+uint fillLights(bool active, ClusterBounds bounds, uint offset, uint writable) {
+    uint lightCount = uint(numLights.x);
+    uint written = 0;
+    for (uint batch = 0; batch < lightCount; batch += GROUP_SIZE) {
+        loadBatch(batch);
+        if (active) {
+            uint batchSize = min(uint(GROUP_SIZE), lightCount - batch);
+            for (uint i = 0; i < batchSize && written < writable; ++i) {
+                if (lightTouchesCluster(i, bounds)) {
+                    lightsIndex[offset + written] = int(batch + i);
+                    written++;
+                }
+            }
+        }
+    }
+    return written;
+}
+
+
+void main() {
+    uint clusterIndex = gl_WorkGroupID.x * GROUP_SIZE + gl_LocalInvocationIndex;
+    // Out-of-range invocations still take part in loading and barriers.
+    bool active = clusterIndex < uint(numClusters);
+    if (activeOnly == 1) {
+        active = clusterIndex < numActive;
+        clusterIndex = active ? activeClusterIds[clusterIndex] : 0u;
+    }
+    ClusterBounds bounds;
+    if (active) {
+        bounds = getClusterBounds(clusterIndex);
+    }
+    uint lightCount = uint(numLights.x);
+
+    if (listFormat == 1) {
+        // Bitsets. GROUP_SIZE is a multiple of 32, so each batch fills whole words.
+        uint numWords = (lightCount + 31) / 32;
+        uint numSummaryWords = (numWords + 31) / 32;
+        uint summary = 0u;
+        for (uint batch = 0; batch < lightCount; batch += GROUP_SIZE) {
+            loadBatch(batch);
+            if (!active) {
+                continue;
+            }
+            uint batchSize = min(uint(GROUP_SIZE), lightCount - batch);
+            for (uint w = 0; w < (batchSize + 31) / 32; ++w) {
+                uint bits = 0u;
+                uint wordSize = min(32u, batchSize - 32 * w);
+                for (uint b = 0; b < wordSize; ++b) {
+                    bits |= uint(lightTouchesCluster(32 * w + b, bounds)) << b;
+                }
+                uint word = batch / 32 + w;
+                lightsIndex[clusterIndex * numWords + word] = int(bits);
+                summary |= uint(bits != 0u) << (word % 32);
+                if (word % 32 == 31 || word == numWords - 1) {
+                    tileLightMapping[clusterIndex * numSummaryWords + word / 32] = int(summary);
+                    summary = 0u;
+                }
+            }
+        }
+        return;
+    }
+
+    uint capacity = uint(lightsIndexCapacity);
+    if (compactPass == 2) {
+        // Fill at the scanned offsets. The buffer is sized from an earlier frame's
+        // total, so it can still be too small; clamp instead of overflowing.
+        uint offset = active ? uint(tileLightMapping[2 * clusterIndex]) : 0u;
+        uint count = active ? uint(tileLightMapping[2 * clusterIndex + 1]) : 0u;
+        uint writable = offset < capacity ? min(count, capacity - offset) : 0u;
+        uint written = fillLights(active, bounds, offset, writable);
+        if (active) {
+            tileLightMapping[2 * clusterIndex + 1] = int(written);
+            if (recordOverflow == 1 && written < count) {
+                atomicAdd(overflowingClusters, 1u);
+            }
+        }
+        return;
+    }
+
+    // Index lists. Counting first means the lists can be packed without a private
+    // per-cluster array or a per-cluster cap.
+    uint count = countLights(active, bounds);
+    if (compactPass == 1) {
+        if (active) {
+            tileLightMapping[2 * clusterIndex + 1] = int(count);
+        }
+        return;
+    }
+
+    // Reserve space in lightsIndex: first within the workgroup, then one global
+    // atomic per workgroup.
+    if (gl_LocalInvocationIndex == 0) {
+        groupCount = 0u;
+    }
+    barrier();
+    uint localOffset = atomicAdd(groupCount, count);
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        groupOffset = atomicAdd(globalIndexCount, groupCount);
+    }
+    barrier();
+    uint offset = groupOffset + localOffset;
+    uint writable = offset < capacity ? min(count, capacity - offset) : 0u;
+
+    // Same tests again, this time writing the indices.
+    uint written = fillLights(active, bounds, offset, writable);
+
+    if (active) {
+        tileLightMapping[2 * clusterIndex] = int(offset);
+        tileLightMapping[2 * clusterIndex + 1] = int(written);
+        if (recordOverflow == 1 && written < count) {
+            atomicAdd(overflowingClusters, 1u);
+        }
+    }
+}
\ No newline at end of file
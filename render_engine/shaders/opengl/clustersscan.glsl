@@ -0,0 +1,57 @@
+#version 430 core
+
+// Exclusive prefix sum over the per-cluster light counts written by the count
+// pass of clusterscull3.glsl. A single workgroup: each invocation sums a contiguous
+// run of clusters, the run totals are scanned in shared memory, and each invocation
+// then writes the offsets for its run.
+#define SCAN_SIZE 1024
+layout(local_size_x = SCAN_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+
+// Binding must align with lightculling_opengl.h
+// (offset, count) per cluster. Counts are read, offsets are written.
+layout(std430, binding = 1) buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// Receives the total number of indices, for sizing lightsIndex.
+layout(std430, binding = 4) buffer globalIndexCountSSBO {
+    uint globalIndexCount;
+};
+
+uniform int numClusters;
+
+shared uint partial[SCAN_SIZE];
+
+
+void main() {
+    uint n = uint(numClusters);
+    uint perThread = (n + SCAN_SIZE - 1) / SCAN_SIZE;
+    uint begin = min(gl_LocalInvocationIndex * perThread, n);
+    uint end = min(begin + perThread, n);
+
+    uint sum = 0u;
+    for (uint c = begin; c < end; ++c) {
+        sum += uint(tileLightMapping[2 * c + 1]);
+    }
+    partial[gl_LocalInvocationIndex] = sum;
+    barrier();
+
+    // Inclusive scan of the run totals (Hillis-Steele).
+    for (uint stride = 1u; stride < SCAN_SIZE; stride *= 2u) {
+        uint v = gl_LocalInvocationIndex >= stride ? partial[gl_LocalInvocationIndex - stride] : 0u;
+        barrier();
+        partial[gl_LocalInvocationIndex] += v;
+        barrier();
+    }
+
+    uint offset = partial[gl_LocalInvocationIndex] - sum;
+    for (uint c = begin; c < end; ++c) {
+        tileLightMapping[2 * c] = int(offset);
+        offset += uint(tileLightMapping[2 * c + 1]);
+    }
+    if (gl_LocalInvocationIndex == SCAN_SIZE - 1) {
+        globalIndexCount = partial[SCAN_SIZE - 1];
+    }
+}
\ No newline at end of file
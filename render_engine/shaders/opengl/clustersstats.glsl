@@ -0,0 +1,76 @@
+#version 430 core
+
+// Light-list statistics for ClusteredGPU, one invocation per cluster. Each
+// workgroup builds its histogram in shared memory and adds it to the stats
+// buffer once, to keep the (mostly empty) first bins from serializing on atomics.
+// Must match statsGroupSize in cullingstats_opengl.h.
+#define GROUP_SIZE 64
+// Must match statsHistogramSize in lightculling_cpu.h.
+#define HISTOGRAM_SIZE 256
+layout(local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 1) readonly buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 2) readonly buffer lightsIndexSSBO
+{
+    int lightsIndex[];
+};
+
+// Layout must match CullingStatsRaw in lightculling_cpu.h. Zeroed before culling.
+layout(std430, binding = 7) buffer statsSSBO
+{
+    uint overflowingClusters;		// Written by clusterscull3.glsl.
+    uint overBudgetClusters;
+    uint maxLights;
+    uint totalIndices;
+    uint histogram[HISTOGRAM_SIZE];
+};
+
+// 0: index lists, 1: bitsets (see LightListFormat in lightculling_opengl.h)
+uniform int listFormat;
+uniform int numClusters;
+uniform int numLights;
+uniform int budget;
+
+shared uint groupHistogram[HISTOGRAM_SIZE];
+
+
+void main() {
+    for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_SIZE; i += GROUP_SIZE) {
+        groupHistogram[i] = 0u;
+    }
+    barrier();
+
+    uint clusterIndex = gl_WorkGroupID.x * GROUP_SIZE + gl_LocalInvocationIndex;
+    if (clusterIndex < uint(numClusters)) {
+        uint count = 0u;
+        if (listFormat == 1) {
+            uint numWords = (uint(numLights) + 31) / 32;
+            for (uint w = 0; w < numWords; ++w) {
+                count += uint(bitCount(uint(lightsIndex[clusterIndex * numWords + w])));
+            }
+        }
+        else {
+            count = uint(tileLightMapping[2 * clusterIndex + 1]);
+        }
+        atomicAdd(groupHistogram[min(count, uint(HISTOGRAM_SIZE - 1))], 1u);
+        atomicMax(maxLights, count);
+        atomicAdd(totalIndices, count);
+        if (count > uint(budget)) {
+            atomicAdd(overBudgetClusters, 1u);
+        }
+    }
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < HISTOGRAM_SIZE; i += GROUP_SIZE) {
+        if (groupHistogram[i] != 0u) {
+            atomicAdd(histogram[i], groupHistogram[i]);
+        }
+    }
+}
\ No newline at end of file
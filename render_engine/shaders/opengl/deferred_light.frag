@@ -14,6 +14,17 @@ uniform vec3 numTiles;
 
 uniform float zNear;
 uniform float zFar;
+// (linearSlices, split, end, unused): how [zNear, zFar] is cut into numTiles.z slices.
+// See LightCullingCPU::DepthSlicing.
+uniform vec4 depthSlicing;
+
+// The static light grid (see LightCullingCPU::StaticLightGrid), in world space.
+// Dims are (0, 0, 0) when it is off.
+uniform ivec3 staticGridDims;
+uniform vec3 staticGridOrigin;
+uniform float staticGridCellSize;
+uniform mat4 worldToView;
+uniform mat4 viewToWorld;
 
 
 
@@ -26,21 +37,25 @@ struct Light {
 	vec4 positionType;			// vec4
 	// Normalized direction for point and spot lights.
 	vec4 direction;				// vec3
-	// Inner & outer angles (radians) for spot lights.
-	vec4 innerOuterAngles;		// vec2
+	// Inner & outer angles (radians) for spot lights, then 1 if the falloff is windowed.
+	vec4 innerOuterAngles;		// vec3
 	// Color.
 	vec4 color;					// vec3
-	// Attenuation: (constant, linear, quadratic).
-	vec4 attenuation;			// vec3
+	// Attenuation: (constant, linear, quadratic), then the range (GO_Light::getRange()).
+	vec4 attenuation;			// vec4
 };
 
 
 // First elem is culling method, second is meta
 // None=0
 // BoundingSphere=1
-// RasterSphere=2 [meta is light index]
-// Tiled=3
-// Clustered=4
+// RasterSphere=2 [meta is light index, or -1 for the global lights]
+// TiledCPU=3
+// ClusteredCPU=4 [meta is 1 for bitset lists]
+// TiledGPU=5
+// ClusteredGPU=6 [meta is 1 for bitset lists]
+// BinnedCPU=7
+// ZBinned=8
 uniform ivec2 cullingMethod;
 
 
@@ -148,8 +163,16 @@ vec3 computeLightFromDir(
 }
 
 
-float computeAttenuation(float dist, vec3 attenuation) {
-	return 1.0 / (attenuation.x + attenuation.y * dist + attenuation.z * dist * dist);
+// Windowed lights fade to exactly 0 at their range, where the culling cuts them off.
+float computeAttenuation(float dist, Light light) {
+	vec4 attenuation = light.attenuation;
+	float falloff = 1.0 / (attenuation.x + attenuation.y * dist + attenuation.z * dist * dist);
+	if (light.innerOuterAngles.z != 0.0) {
+		float x = dist / attenuation.w;
+		float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+		falloff *= window * window;
+	}
+	return falloff;
 }
 
 
@@ -177,10 +200,16 @@ vec3 processLight(
 		// Point.
 		vec3 diff = light.positionType.xyz - position;
 		dirToLight = normalize(diff);
-		lightColor *= computeAttenuation(length(diff), vec3(light.attenuation));
+		lightColor *= computeAttenuation(length(diff), light);
 	}
 	else if (type == 3.0) {
-		// Spot.
+		// Spot. Point light attenuation, faded between the inner and outer angles.
+		vec3 diff = light.positionType.xyz - position;
+		dirToLight = normalize(diff);
+		float cosAngle = dot(-dirToLight, vec3(light.direction));
+		vec2 cosInnerOuter = cos(light.innerOuterAngles.xy);
+		float spot = clamp((cosAngle - cosInnerOuter.y) / max(cosInnerOuter.x - cosInnerOuter.y, 0.0001), 0.0, 1.0);
+		lightColor *= spot * computeAttenuation(length(diff), light);
 	}
 
 	return computeLightFromDir(
@@ -196,7 +225,7 @@ vec3 processLight(
 
 
 
-// Binding must align with rp_deferred_opengl.h
+// Binding must align with lightculling_opengl.h
 layout(std430, binding = 0) buffer lightBuffer
 {
 	// 4 elements to avoid alignment issues. Only use the first one.
@@ -214,34 +243,123 @@ Light getLightData(int idx) {
 	return l;
 }
 
-// Binding must align with rp_deferred_opengl.h
+// Binding must align with lightculling_opengl.h
+// Directional lights, and point and spot lights with an infinite range. They reach
+// every pixel, so they skip culling and every method loops over all of them.
+layout(std430, binding = 8) buffer globalLightBuffer
+{
+	ivec4 numGlobalLights;
+	vec4 globalLightData[];
+};
+Light getGlobalLightData(int idx) {
+	Light l;
+	int offset = idx * 5;
+	l.positionType = globalLightData[offset + 0];
+	l.direction = globalLightData[offset + 1];
+	l.innerOuterAngles = globalLightData[offset + 2];
+	l.color = globalLightData[offset + 3];
+	l.attenuation = globalLightData[offset + 4];
+	return l;
+}
+
+// Binding must align with lightculling_opengl.h
+// Static lights (GO_Light::isStatic), in world space. Only reached through the static light grid.
+layout(std430, binding = 16) buffer staticLightBuffer
+{
+	ivec4 numStaticLights;
+	vec4 staticLightData[];
+};
+// In view space, like the other lights.
+Light getStaticLightData(int idx) {
+	Light l;
+	int offset = idx * 5;
+	l.positionType = staticLightData[offset + 0];
+	l.direction = staticLightData[offset + 1];
+	l.innerOuterAngles = staticLightData[offset + 2];
+	l.color = staticLightData[offset + 3];
+	l.attenuation = staticLightData[offset + 4];
+	l.positionType.xyz = vec3(worldToView * vec4(l.positionType.xyz, 1.0));
+	l.direction.xyz = mat3(worldToView) * l.direction.xyz;
+	return l;
+}
+
+// Binding must align with lightculling_opengl.h
+// (offset, count) per cell, x + y*X + z*X*Y, followed by the light indices the offsets point into.
+layout(std430, binding = 17) buffer staticLightGridSSBO
+{
+	int staticLightGrid[];
+};
+
+// Binding must align with lightculling_opengl.h
 layout(std430, binding = 1) buffer tileLightMappingSSBO
 {
 	int tileLightMapping[];
 };
 
-// Binding must align with rp_deferred_opengl.h
+// Binding must align with lightculling_opengl.h
 layout(std430, binding = 2) buffer lightsIndexSSBO
 {
 	int lightsIndex[];
 };
 
+// Binding must align with lightculling_opengl.h
+// ZBinned: (first, last) depth-sorted light index per depth bin.
+layout(std430, binding = 5) buffer zBinsSSBO
+{
+	int zBins[];
+};
+
+// Binding must align with lightculling_opengl.h
+// ZBinned: (numLights + 31) / 32 words per tile, one bit per depth-sorted light.
+layout(std430, binding = 6) buffer tileMasksSSBO
+{
+	uint tileMasks[];
+};
+
 
 
 // pos: vec3, radius float
+// For spot lights, the smallest sphere around the cone.
 vec4 getBoundingSphere(Light light) {
-	const float thresh = 0.02f;
-	// See computation in go_light.cpp
-	float color = max(max(light.color.r, light.color.g), light.color.b);
-	float atten = light.attenuation.z;
-	float rad = sqrt(color / (thresh * atten));
-	return vec4(light.positionType.xyz, rad);
+	// Computed once per light on the CPU, see GO_Light::getRange().
+	float rad = light.attenuation.w;
+	float angle = light.innerOuterAngles.y;
+	if (light.positionType.w != 3.0 || angle >= 0.5 * PI) {
+		return vec4(light.positionType.xyz, rad);
+	}
+	vec3 dir = vec3(light.direction);
+	if (angle <= 0.25 * PI) {
+		float coneRad = rad / (2.0 * cos(angle));
+		return vec4(light.positionType.xyz + coneRad * dir, coneRad);
+	}
+	return vec4(light.positionType.xyz + rad * cos(angle) * dir, rad * sin(angle));
 }
 
 
 
 
 
+// Same as LightCullingCPU::DepthSlicing::slice(): the cluster slice of a view depth.
+int depthSlice(float depth) {
+	int numSlices = int(numTiles.z);
+	int linearSlices = int(depthSlicing.x);
+	float k;
+	if (depth <= zNear) {
+		return 0;
+	}
+	else if (depth < depthSlicing.y) {
+		k = float(linearSlices) * (depth - zNear) / (depthSlicing.y - zNear);
+	}
+	else if (linearSlices >= numSlices) {
+		return numSlices - 1;
+	}
+	else {
+		k = float(linearSlices) + float(numSlices - linearSlices) * log2(depth / depthSlicing.y) / log2(depthSlicing.z / depthSlicing.y);
+	}
+	return clamp(int(k), 0, numSlices - 1);
+}
+
+
 void main() {
 
 	vec2 uv = (gl_FragCoord.xy - 0.5) / viewportSize;
@@ -271,7 +389,7 @@ void main() {
 		for (int i = 0; i < numLights.x; i++) {
 			Light l = getLightData(i);
 			vec4 boundingSphere = getBoundingSphere(l);
-			if (l.positionType.w == 2.0 &&
+			if ((l.positionType.w == 2.0 || l.positionType.w == 3.0) &&
 				distance(position, boundingSphere.xyz) >= boundingSphere.w) {
 				// Outside the sphere, cull the light
 				continue;
@@ -289,18 +407,20 @@ void main() {
 	else if (cullingMethod.x == 2) {
 		// RasterSphere
 		int lightIdx = cullingMethod.y;
-		color += vec4(processLight(
-			getLightData(lightIdx),
-			position,
-			albedo,
-			metalRough.x,
-			metalRough.y,
-			normal
-		), 0.0);
+		if (lightIdx >= 0) {
+			color += vec4(processLight(
+				getLightData(lightIdx),
+				position,
+				albedo,
+				metalRough.x,
+				metalRough.y,
+				normal
+			), 0.0);
+		}
 	}
-	else if (cullingMethod.x == 3) {
-		// Tiled
-		ivec2 tileCoord = ivec2(floor(uv * numTiles.xy));
+	else if (cullingMethod.x == 3 || cullingMethod.x == 5) {
+		// Tiled (the CPU culler and the depth-bounded GPU culler write the same layout)
+		ivec2 tileCoord = ivec2(numTiles.xy * gl_FragCoord.xy / viewportSize.xy);
 		int startIdx = tileLightMapping[2 * (tileCoord.y * int(numTiles.x) + tileCoord.x)];
 		int numIdxs =  tileLightMapping[2 * (tileCoord.y * int(numTiles.x) + tileCoord.x) + 1];
 		for (int i = 0; i < numIdxs; i++) {
@@ -316,23 +436,97 @@ void main() {
 			), 0.0);
 		}
 	}
-	else if (cullingMethod.x == 6) {
-		// Clustered
-		float scale = numTiles.z / log2(zFar / zNear);
-		float bias = -(numTiles.z * log2(zNear) / log2(zFar / zNear));
-		uint zTile     = uint(max(log2(-position.z) * scale + bias, 0.0));
+	else if (cullingMethod.x == 4 || cullingMethod.x == 6 || cullingMethod.x == 7) {
+		// Clustered (the CPU, GPU and binning cullers write the same layout)
+		uint zTile     = uint(depthSlice(-position.z));
 	    uvec3 tiles    = uvec3( uvec2( numTiles.xy * gl_FragCoord.xy / viewportSize.xy ), zTile);
 		uint tileIndex = tiles.x +
                      uint(numTiles.x) * tiles.y +
                      uint(numTiles.x * numTiles.y) * tiles.z;
-		int lightCount       = tileLightMapping[2*tileIndex+1];
-		int lightIndexOffset = tileLightMapping[2*tileIndex];
-		for (int i = 0; i < lightCount; i++) {
-			//color += vec4(0.1, 0.0, 0.0, 0.0);
-			int lightIdx = lightsIndex[lightIndexOffset + i];
-			Light light = getLightData(lightIdx);
+		if (cullingMethod.y == 1) {
+			// Bitset lists: skip empty groups of 32 lights using the summary mask.
+			int numWords = (numLights.x + 31) / 32;
+			int numSummaryWords = (numWords + 31) / 32;
+			for (int s = 0; s < numSummaryWords; s++) {
+				uint summary = uint(tileLightMapping[int(tileIndex) * numSummaryWords + s]);
+				while (summary != 0u) {
+					int w = 32 * s + findLSB(summary);
+					summary &= summary - 1u;
+					uint bits = uint(lightsIndex[int(tileIndex) * numWords + w]);
+					while (bits != 0u) {
+						int lightIdx = 32 * w + findLSB(bits);
+						bits &= bits - 1u;
+						Light light = getLightData(lightIdx);
+						color += vec4(processLight(
+							light,
+							position,
+							albedo,
+							metalRough.x,
+							metalRough.y,
+							normal
+						), 0.0);
+					}
+				}
+			}
+		}
+		else {
+			int lightCount       = tileLightMapping[2*tileIndex+1];
+			int lightIndexOffset = tileLightMapping[2*tileIndex];
+			for (int i = 0; i < lightCount; i++) {
+				//color += vec4(0.1, 0.0, 0.0, 0.0);
+				int lightIdx = lightsIndex[lightIndexOffset + i];
+				Light light = getLightData(lightIdx);
+				color += vec4(processLight(
+					light,
+					position,
+					albedo,
+					metalRough.x,
+					metalRough.y,
+					normal
+				), 0.0);
+			}
+		}
+	}
+	else if (cullingMethod.x == 8) {
+		// ZBinned: the depth bin gives a range of sorted lights, the tile mask says which are in this tile.
+		int zBin = depthSlice(-position.z);
+		int first = zBins[2 * zBin];
+		int last = zBins[2 * zBin + 1];
+		ivec2 tileCoord = ivec2(numTiles.xy * gl_FragCoord.xy / viewportSize.xy);
+		int wordsPerTile = (numLights.x + 31) / 32;
+		int maskOffset = (tileCoord.y * int(numTiles.x) + tileCoord.x) * wordsPerTile;
+		if (first <= last) {
+			for (int w = first / 32; w <= last / 32; w++) {
+				uint mask = tileMasks[maskOffset + w];
+				if (w == first / 32)
+					mask &= ~0u << uint(first % 32);
+				if (w == last / 32)
+					mask &= ~0u >> uint(31 - last % 32);
+				while (mask != 0u) {
+					int lightIdx = 32 * w + findLSB(mask);
+					mask &= mask - 1u;
+					Light light = getLightData(lightIdx);
+					color += vec4(processLight(
+						light,
+						position,
+						albedo,
+						metalRough.x,
+						metalRough.y,
+						normal
+					), 0.0);
+				}
+			}
+		}
+	}
+	else {
+		color += vec4(1.0, 0.0, 1.0, 0.0);
+	}
+
+	// RasterSphere draws the global lights in their own pass.
+	if (cullingMethod.x != 2 || cullingMethod.y < 0) {
+		for (int i = 0; i < numGlobalLights.x; i++) {
 			color += vec4(processLight(
-				light,
+				getGlobalLightData(i),
 				position,
 				albedo,
 				metalRough.x,
@@ -341,8 +535,27 @@ void main() {
 			), 0.0);
 		}
 	}
-	else {
-		color += vec4(1.0, 0.0, 1.0, 0.0);
+
+	// Static lights, from the cell of the world-space grid this pixel is in.
+	if (staticGridDims.x > 0) {
+		vec3 worldPosition = vec3(viewToWorld * vec4(position, 1.0));
+		ivec3 cell = ivec3(floor((worldPosition - staticGridOrigin) / staticGridCellSize));
+		if (all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, staticGridDims))) {
+			int numCells = staticGridDims.x * staticGridDims.y * staticGridDims.z;
+			int cellIndex = cell.x + staticGridDims.x * (cell.y + staticGridDims.y * cell.z);
+			int lightIndexOffset = 2 * numCells + staticLightGrid[2 * cellIndex];
+			int lightCount = staticLightGrid[2 * cellIndex + 1];
+			for (int i = 0; i < lightCount; i++) {
+				color += vec4(processLight(
+					getStaticLightData(staticLightGrid[lightIndexOffset + i]),
+					position,
+					albedo,
+					metalRough.x,
+					metalRough.y,
+					normal
+				), 0.0);
+			}
+		}
 	}
 	
 	outColor = color;
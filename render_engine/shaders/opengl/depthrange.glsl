@@ -0,0 +1,53 @@
+#version 430 core
+
+// Adaptive depth slicing: reduces the depth buffer of the Z pre-pass (forward) or the
+// gBuffer pass (deferred) to the (min, max) view depth of everything drawn, one
+// invocation per pixel. Each workgroup reduces in shared memory and then updates the
+// result once. Read back a few frames later, see updateDepthSlicing() in
+// lightculling_opengl.cpp.
+#define GROUP_SIZE 16
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE, local_size_z = 1) in;
+
+
+uniform sampler2D depthTex;
+uniform vec2 viewportSize;
+uniform float zNear;
+uniform float zFar;
+
+// Binding must align with lightculling_opengl.h
+// Float bits. Reset to (+inf, 0) before the dispatch; stays that way if nothing was drawn.
+layout(std430, binding = 14) buffer depthRangeSSBO
+{
+    uint depthMin;
+    uint depthMax;
+};
+
+// View depths are positive, so their bit patterns order the same way as the floats.
+shared uint groupMin;
+shared uint groupMax;
+
+
+void main() {
+    if (gl_LocalInvocationIndex == 0) {
+        groupMin = floatBitsToUint(1.0 / 0.0);
+        groupMax = 0u;
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (pixel.x < int(viewportSize.x) && pixel.y < int(viewportSize.y)) {
+        float d = texelFetch(depthTex, pixel, 0).r;
+        if (d < 1.0) {
+            float ndc = 2.0 * d - 1.0;
+            float viewDepth = 2.0 * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+            atomicMin(groupMin, floatBitsToUint(viewDepth));
+            atomicMax(groupMax, floatBitsToUint(viewDepth));
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0 && groupMax != 0u) {
+        atomicMin(depthMin, groupMin);
+        atomicMax(depthMax, groupMax);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,340 @@
+#version 430 core
+
+// TiledGPU, pass 2: depth-bounded tiled culling ("Forward+"). One invocation per
+// screen tile, GROUP_SIZE_X x GROUP_SIZE_Y tiles per workgroup. Each tile is only
+// tested over the view depths tilesdepth.glsl found in it, instead of the whole
+// frustum depth. The workgroup's rectangle and combined depth range are a coarser
+// second level: each light is tested against them once as it is staged, and lights
+// that miss are skipped by every tile in the group. Writes one layer of the same
+// (offset, count) + index lists as the clustered cullers.
+// Must match tileCullGroupSize in lightculling_opengl.h.
+#define GROUP_SIZE_X 8
+#define GROUP_SIZE_Y 8
+#define GROUP_SIZE (GROUP_SIZE_X * GROUP_SIZE_Y)
+layout(local_size_x = GROUP_SIZE_X, local_size_y = GROUP_SIZE_Y, local_size_z = 1) in;
+
+
+
+// Light parameters.
+// We always use vec4 to avoid common alignment bugs in the OpenGL drivers
+struct Light {
+    // Position (xyz) and type (w).
+    // Type matches the enum in go_light.h.
+    // None=0, Dir=1, Point=2, Spot=3.
+    vec4 positionType;			// vec4
+    // Normalized direction for point and spot lights.
+    vec4 direction;				// vec3
+    // Inner & outer angles (radians) for spot lights, then 1 if the falloff is windowed.
+    vec4 innerOuterAngles;		// vec3
+    // Color.
+    vec4 color;					// vec3
+    // Attenuation: (constant, linear, quadratic), then the range (GO_Light::getRange()).
+    vec4 attenuation;			// vec4
+};
+
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 0) readonly buffer lightBuffer
+{
+    // 4 elements to avoid alignment issues. Only use the first one.
+    ivec4 numLights;
+    vec4 lightData[];
+};
+Light getLightData(int idx) {
+    Light l;
+    int offset = idx * 5;
+    l.positionType = lightData[offset + 0];
+    l.direction = lightData[offset + 1];
+    l.innerOuterAngles = lightData[offset + 2];
+    l.color = lightData[offset + 3];
+    l.attenuation = lightData[offset + 4];
+    return l;
+}
+
+
+// Binding must align with lightculling_opengl.h
+// (min, max) view depth per tile; min > max for tiles with no geometry.
+layout(std430, binding = 11) readonly buffer tileDepthBoundsSSBO
+{
+    vec2 tileDepthBounds[];
+};
+
+// Binding must align with lightculling_opengl.h
+// (offset, count) per tile.
+layout(std430, binding = 1) buffer tileLightMappingSSBO
+{
+    int tileLightMapping[];
+};
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 2) writeonly buffer lightsIndexSSBO
+{
+    int lightsIndex[];
+};
+
+// Must be zeroed before the dispatch.
+layout(std430, binding = 4) buffer globalIndexCountSSBO {
+    uint globalIndexCount;
+};
+
+// Size of lightsIndex in ints. Lists are truncated rather than written past the end.
+uniform int lightsIndexCapacity;
+// Stats for clustersstats.glsl; only bound when recordOverflow is 1.
+layout(std430, binding = 7) buffer statsSSBO
+{
+    uint overflowingClusters;
+};
+uniform int recordOverflow;
+
+uniform ivec2 numTiles;
+uniform vec2 projScale;		// (proj[0][0], proj[1][1])
+uniform float zNear;
+uniform float zFar;
+
+
+// Same as in clusterscull3.glsl: the current batch of lights.
+shared vec4 sharedSpheres[GROUP_SIZE];
+shared vec4 sharedRects[GROUP_SIZE];
+shared vec2 sharedDepths[GROUP_SIZE];
+shared vec4 sharedConeAxes[GROUP_SIZE];
+shared vec4 sharedConeApexes[GROUP_SIZE];
+// Combined depth range of the workgroup's tiles, as float bits.
+shared uint groupDepthMin;
+shared uint groupDepthMax;
+shared uint groupCount;
+shared uint groupOffset;
+
+
+const float PI = 3.14159265358979323;
+
+// Computed once per light on the CPU, see GO_Light::getRange().
+float getRange(Light light) {
+    return light.attenuation.w;
+}
+
+// pos: vec3, radius float
+// For spot lights, the smallest sphere around the cone.
+vec4 getBoundingSphere(Light light) {
+    float rad = getRange(light);
+    float angle = light.innerOuterAngles.y;
+    if (light.positionType.w != 3.0 || angle >= 0.5 * PI) {
+        return vec4(light.positionType.xyz, rad);
+    }
+    vec3 dir = light.direction.xyz;
+    if (angle <= 0.25 * PI) {
+        float coneRad = rad / (2.0 * cos(angle));
+        return vec4(light.positionType.xyz + coneRad * dir, coneRad);
+    }
+    return vec4(light.positionType.xyz + rad * cos(angle) * dir, rad * sin(angle));
+}
+
+// Same as projectedSlopeRange() in lightculling_cpu.cpp: the range of x / depth
+// over one axis of the sphere, clipped to depth >= zNear.
+vec2 projectedSlopeRange(float c, float d0, float radius) {
+    float lenSq = c * c + d0 * d0;
+    float tangentLen = sqrt(lenSq - radius * radius);
+    vec2 range = vec2(1e30, -1e30);
+    for (int i = 0; i < 2; ++i) {
+        float side = i == 0 ? -1.0 : 1.0;
+        float x = tangentLen * (c * tangentLen - side * d0 * radius) / lenSq;
+        float depth = tangentLen * (d0 * tangentLen + side * c * radius) / lenSq;
+        if (depth >= zNear) {
+            range = vec2(min(range.x, x / depth), max(range.y, x / depth));
+        }
+    }
+    float nearOffset = zNear - d0;
+    if (abs(nearOffset) < radius) {
+        float halfChord = sqrt(radius * radius - nearOffset * nearOffset);
+        range = vec2(min(range.x, (c - halfChord) / zNear), max(range.y, (c + halfChord) / zNear));
+    }
+    return range;
+}
+
+// Same as projectSphere() in lightculling_cpu.cpp. Returns false if the sphere is
+// entirely outside [zNear, zFar].
+bool projectSphere(vec4 sphere, out vec4 rect, out vec2 depthRange) {
+    float depth = -sphere.z;
+    if (depth + sphere.w < zNear || depth - sphere.w > zFar) {
+        return false;
+    }
+    depthRange = vec2(max(depth - sphere.w, zNear), min(depth + sphere.w, zFar));
+    if (dot(sphere.xyz, sphere.xyz) <= sphere.w * sphere.w) {
+        rect = vec4(-1e30, -1e30, 1e30, 1e30);
+        return true;
+    }
+    vec2 xRange = projectedSlopeRange(sphere.x, depth, sphere.w);
+    vec2 yRange = projectedSlopeRange(sphere.y, depth, sphere.w);
+    rect = 0.5 * vec4(projScale * vec2(xRange.x, yRange.x), projScale * vec2(xRange.y, yRange.y)) + 0.5;
+    return true;
+}
+
+// Must be called by the whole workgroup (it contains barriers). Lights outside the
+// workgroup's rectangle or depth range get an empty rectangle.
+void loadBatch(uint batchStart, vec4 groupRect, vec2 groupDepthRange) {
+    uint lightIdx = batchStart + gl_LocalInvocationIndex;
+    vec4 sphere = vec4(0.0);
+    vec4 rect = vec4(1.0, 1.0, 0.0, 0.0);
+    vec2 depthRange = vec2(0.0);
+    vec4 coneAxis = vec4(0.0, 0.0, 0.0, -2.0);
+    vec4 coneApex = vec4(0.0);
+    if (lightIdx < uint(numLights.x)) {
+        Light light = getLightData(int(lightIdx));
+        if (light.positionType.w == 2.0 || light.positionType.w == 3.0) {
+            sphere = getBoundingSphere(light);
+            if (!projectSphere(sphere, rect, depthRange) ||
+                rect.x > groupRect.z || rect.z < groupRect.x || rect.y > groupRect.w || rect.w < groupRect.y ||
+                depthRange.x > groupDepthRange.y || depthRange.y < groupDepthRange.x) {
+                rect = vec4(1.0, 1.0, 0.0, 0.0);
+            }
+            if (light.positionType.w == 3.0 && light.innerOuterAngles.y < 0.5 * PI) {
+                coneAxis = vec4(light.direction.xyz, cos(light.innerOuterAngles.y));
+                coneApex = vec4(light.positionType.xyz, getRange(light));
+            }
+        }
+        else {
+            sphere = vec4(0.0, 0.0, 0.0, -1.0);
+        }
+    }
+    // Wait until everyone is done with the previous batch.
+    barrier();
+    sharedSpheres[gl_LocalInvocationIndex] = sphere;
+    sharedRects[gl_LocalInvocationIndex] = rect;
+    sharedDepths[gl_LocalInvocationIndex] = depthRange;
+    sharedConeAxes[gl_LocalInvocationIndex] = coneAxis;
+    sharedConeApexes[gl_LocalInvocationIndex] = coneApex;
+    barrier();
+}
+
+// The tile's screen rectangle, its depth bounds, and the view-space box of the
+// frustum between them.
+struct TileBounds {
+    vec3 aabbMin;
+    vec3 aabbMax;
+    vec4 sphere;			// Around the AABB, for the cone test.
+    vec4 rect;
+    vec2 depthRange;
+};
+
+TileBounds getTileBounds(ivec2 tile) {
+    TileBounds bounds;
+    bounds.rect = vec4(vec2(tile), vec2(tile + 1)) / vec4(numTiles, numTiles);
+    bounds.depthRange = tileDepthBounds[tile.y * numTiles.x + tile.x];
+    bounds.aabbMin = vec3(1e30);
+    bounds.aabbMax = vec3(-1e30);
+    for (int i = 0; i < 4; ++i) {
+        vec2 corner = vec2(i % 2 == 0 ? bounds.rect.x : bounds.rect.z, i < 2 ? bounds.rect.y : bounds.rect.w);
+        // The view-space ray through the corner, at unit depth.
+        vec3 ray = vec3((2.0 * corner - 1.0) / projScale, -1.0);
+        bounds.aabbMin = min(bounds.aabbMin, min(ray * bounds.depthRange.x, ray * bounds.depthRange.y));
+        bounds.aabbMax = max(bounds.aabbMax, max(ray * bounds.depthRange.x, ray * bounds.depthRange.y));
+    }
+    bounds.sphere = vec4(0.5 * (bounds.aabbMin + bounds.aabbMax), 0.5 * length(bounds.aabbMax - bounds.aabbMin));
+    return bounds;
+}
+
+// Same as coneTouchesCluster() in lightculling_cpu.cpp: rejects the tile's
+// bounding sphere if it is outside the cone's angle or wholly in front of or behind it.
+bool coneTouchesSphere(vec4 coneAxis, vec4 coneApex, vec4 sphere) {
+    vec3 v = sphere.xyz - coneApex.xyz;
+    float alongAxis = dot(v, coneAxis.xyz);
+    float coneSin = sqrt(max(1.0 - coneAxis.w * coneAxis.w, 0.0));
+    float distToCone = coneAxis.w * sqrt(max(dot(v, v) - alongAxis * alongAxis, 0.0)) - alongAxis * coneSin;
+    return !(distToCone > sphere.w || alongAxis > sphere.w + coneApex.w || alongAxis < -sphere.w);
+}
+
+// Same tests as lightTouchesCluster() in clusterscull3.glsl, with the tile's box.
+bool lightTouchesTile(uint i, TileBounds bounds) {
+    vec4 sphere = sharedSpheres[i];
+    if (sphere.w < 0.0) {
+        return true;
+    }
+    vec4 rect = sharedRects[i];
+    vec2 depthRange = sharedDepths[i];
+    if (rect.x > bounds.rect.z || rect.z < bounds.rect.x || rect.y > bounds.rect.w || rect.w < bounds.rect.y ||
+        depthRange.x > bounds.depthRange.y || depthRange.y < bounds.depthRange.x) {
+        return false;
+    }
+    vec3 d = max(max(bounds.aabbMin - sphere.xyz, sphere.xyz - bounds.aabbMax), 0.0);
+    if (dot(d, d) > sphere.w * sphere.w) {
+        return false;
+    }
+    vec4 coneAxis = sharedConeAxes[i];
+    return coneAxis.w < -1.0 || coneTouchesSphere(coneAxis, sharedConeApexes[i], bounds.sphere);
+}
+
+
+void main() {
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    // Out-of-range invocations, and tiles with nothing drawn, still take part in
+    // loading and barriers.
+    bool active = all(lessThan(tile, numTiles));
+    uint tileIndex = uint(tile.y * numTiles.x + tile.x);
+    TileBounds bounds;
+    bool testing = false;
+    if (gl_LocalInvocationIndex == 0) {
+        groupDepthMin = floatBitsToUint(1.0 / 0.0);
+        groupDepthMax = 0u;
+        groupCount = 0u;
+    }
+    barrier();
+    if (active) {
+        bounds = getTileBounds(tile);
+        testing = bounds.depthRange.x <= bounds.depthRange.y;
+        if (testing) {
+            atomicMin(groupDepthMin, floatBitsToUint(bounds.depthRange.x));
+            atomicMax(groupDepthMax, floatBitsToUint(bounds.depthRange.y));
+        }
+    }
+    barrier();
+    ivec2 groupTile = ivec2(gl_WorkGroupID.xy) * ivec2(GROUP_SIZE_X, GROUP_SIZE_Y);
+    vec4 groupRect = vec4(vec2(groupTile), vec2(min(groupTile + ivec2(GROUP_SIZE_X, GROUP_SIZE_Y), numTiles))) /
+        vec4(numTiles, numTiles);
+    vec2 groupDepthRange = vec2(uintBitsToFloat(groupDepthMin), uintBitsToFloat(groupDepthMax));
+
+    uint lightCount = uint(numLights.x);
+    uint count = 0u;
+    for (uint batch = 0; batch < lightCount; batch += GROUP_SIZE) {
+        loadBatch(batch, groupRect, groupDepthRange);
+        if (testing) {
+            uint batchSize = min(uint(GROUP_SIZE), lightCount - batch);
+            for (uint i = 0; i < batchSize; ++i) {
+                count += uint(lightTouchesTile(i, bounds));
+            }
+        }
+    }
+
+    // Reserve space in lightsIndex: first within the workgroup, then one global
+    // atomic per workgroup.
+    uint localOffset = atomicAdd(groupCount, count);
+    barrier();
+    if (gl_LocalInvocationIndex == 0) {
+        groupOffset = atomicAdd(globalIndexCount, groupCount);
+    }
+    barrier();
+    uint offset = groupOffset + localOffset;
+    uint capacity = uint(lightsIndexCapacity);
+    uint writable = offset < capacity ? min(count, capacity - offset) : 0u;
+
+    // Same tests again, this time writing the indices.
+    uint written = 0u;
+    for (uint batch = 0; batch < lightCount; batch += GROUP_SIZE) {
+        loadBatch(batch, groupRect, groupDepthRange);
+        if (testing) {
+            uint batchSize = min(uint(GROUP_SIZE), lightCount - batch);
+            for (uint i = 0; i < batchSize && written < writable; ++i) {
+                if (lightTouchesTile(i, bounds)) {
+                    lightsIndex[offset + written] = int(batch + i);
+                    written++;
+                }
+            }
+        }
+    }
+
+    if (active) {
+        tileLightMapping[2 * tileIndex] = int(offset);
+        tileLightMapping[2 * tileIndex + 1] = int(written);
+        if (recordOverflow == 1 && written < count) {
+            atomicAdd(overflowingClusters, 1u);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#version 430 core
+
+// TiledGPU, pass 1: reduces the depth buffer from the Z pre-pass (forward) or the
+// gBuffer pass (deferred) to the (min, max) view depth of each screen tile, one
+// workgroup per tile. Pixels still at the far plane (nothing drawn) are skipped, so
+// a tile with no geometry gets an empty range (min > max) and culls every light.
+#define GROUP_SIZE 16
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE, local_size_z = 1) in;
+
+
+uniform sampler2D depthTex;
+uniform ivec2 numTiles;
+uniform vec2 viewportSize;
+uniform float zNear;
+uniform float zFar;
+
+// Binding must align with lightculling_opengl.h
+layout(std430, binding = 11) writeonly buffer tileDepthBoundsSSBO
+{
+    vec2 tileDepthBounds[];
+};
+
+// View depths are positive, so their bit patterns order the same way as the floats.
+shared uint groupMin;
+shared uint groupMax;
+
+
+void main() {
+    ivec2 tile = ivec2(gl_WorkGroupID.xy);
+    if (gl_LocalInvocationIndex == 0) {
+        groupMin = floatBitsToUint(1.0 / 0.0);
+        groupMax = 0u;
+    }
+    barrier();
+
+    // The shading passes put pixel p in tile floor(numTiles * (p + 0.5) / viewportSize).
+    vec2 tileSize = viewportSize / vec2(numTiles);
+    ivec2 begin = max(ivec2(ceil(vec2(tile) * tileSize - 0.5)), ivec2(0));
+    ivec2 end = min(ivec2(ceil(vec2(tile + 1) * tileSize - 0.5)), ivec2(viewportSize));
+
+    float localMin = 1.0 / 0.0;
+    float localMax = 0.0;
+    for (int y = begin.y + int(gl_LocalInvocationID.y); y < end.y; y += GROUP_SIZE) {
+        for (int x = begin.x + int(gl_LocalInvocationID.x); x < end.x; x += GROUP_SIZE) {
+            float d = texelFetch(depthTex, ivec2(x, y), 0).r;
+            if (d < 1.0) {
+                float ndc = 2.0 * d - 1.0;
+                float viewDepth = 2.0 * zNear * zFar / (zFar + zNear - ndc * (zFar - zNear));
+                localMin = min(localMin, viewDepth);
+                localMax = max(localMax, viewDepth);
+            }
+        }
+    }
+    atomicMin(groupMin, floatBitsToUint(localMin));
+    atomicMax(groupMax, floatBitsToUint(localMax));
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0) {
+        // Padded slightly: the deferred pass shades from half-float positions, which
+        // can land just outside the range of the depth buffer.
+        vec2 bounds = vec2(uintBitsToFloat(groupMin), uintBitsToFloat(groupMax));
+        tileDepthBounds[tile.y * numTiles.x + tile.x] = bounds * vec2(0.999, 1.001);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "utils/threadpool.h"
+
+#include <algorithm>
+#include <memory>
+
+
+namespace Utils {
+
+	ThreadPool::ThreadPool(size_t numThreads) {
+		if (numThreads == 0) {
+			numThreads = std::max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+		}
+		// The calling thread counts as one of the threads.
+		for (size_t i = 1; i < numThreads; i++) {
+			this->workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(this->jobsMutex);
+			this->stopping = true;
+		}
+		this->jobsCV.notify_all();
+		for (std::thread& worker : this->workers) {
+			worker.join();
+		}
+	}
+
+
+	size_t ThreadPool::getNumThreads() {
+		return this->workers.size() + 1;
+	}
+
+
+	std::future<void> ThreadPool::submit(std::function<void()> job) {
+		// packaged_task is move-only, but std::function must be copyable.
+		auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+		std::future<void> future = task->get_future();
+		if (this->workers.empty()) {
+			(*task)();
+			return future;
+		}
+		{
+			std::lock_guard<std::mutex> lock(this->jobsMutex);
+			this->jobs.push([task]() { (*task)(); });
+		}
+		this->jobsCV.notify_one();
+		return future;
+	}
+
+
+	void ThreadPool::parallelFor(size_t count, size_t chunkSize,
+		const std::function<void(size_t begin, size_t end)>& func) {
+		if (count == 0) {
+			return;
+		}
+		chunkSize = std::max(chunkSize, (size_t)1);
+		size_t numChunks = (count + chunkSize - 1) / chunkSize;
+
+		// Queue every chunk but the first, which the calling thread runs itself.
+		std::vector<std::future<void>> pending;
+		pending.reserve(numChunks - 1);
+		for (size_t c = 1; c < numChunks; c++) {
+			size_t begin = c * chunkSize;
+			size_t end = std::min(begin + chunkSize, count);
+			pending.push_back(this->submit([&func, begin, end]() { func(begin, end); }));
+		}
+		func(0, std::min(chunkSize, count));
+		for (std::future<void>& f : pending) {
+			f.get();
+		}
+	}
+
+
+	void ThreadPool::workerLoop() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(this->jobsMutex);
+				this->jobsCV.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+				if (this->stopping && this->jobs.empty()) {
+					return;
+				}
+				job = std::move(this->jobs.front());
+				this->jobs.pop();
+			}
+			job();
+		}
+	}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+namespace Utils {
+
+	/*
+	* A fixed-size pool of worker threads pulling jobs from a single FIFO queue.
+	* The pool is meant to be created once and reused every frame, since spawning
+	* threads per frame would cost more than most of the work we hand to it.
+	*/
+	class ThreadPool {
+	public:
+
+		/*
+		* Creates a pool with the given total number of threads, including the calling
+		* thread (which participates in parallelFor). If 0, uses the hardware concurrency.
+		*/
+		ThreadPool(size_t numThreads = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+		~ThreadPool();
+
+		/*
+		* Returns the number of threads that run parallelFor chunks (workers + caller).
+		*/
+		size_t getNumThreads();
+
+		/*
+		* Queues a job to run on a worker thread. The returned future becomes ready
+		* when the job has finished.
+		*/
+		std::future<void> submit(std::function<void()> job);
+
+		/*
+		* Splits [0, count) into chunks of chunkSize elements and calls func(begin, end)
+		* once per chunk. Chunk k always covers [k * chunkSize, (k+1) * chunkSize), so
+		* callers can index per-chunk storage with begin / chunkSize.
+		* Blocks until every chunk has completed.
+		*/
+		void parallelFor(size_t count, size_t chunkSize,
+			const std::function<void(size_t begin, size_t end)>& func);
+
+	private:
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> jobs;
+		std::mutex jobsMutex;
+		std::condition_variable jobsCV;
+		bool stopping = false;
+
+		void workerLoop();
+
+	};
+
+}